@@ -0,0 +1,55 @@
+#pragma once
+
+#include "types.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Helpers shared by the benchmarks, each of which is its own executable printing a small table
+namespace Bench {
+
+// Runs f once to warm up, then the given number of times, and returns the median in milliseconds
+template <typename F> f64 median_ms(u32 runs, F&& f) {
+	f();
+	std::vector<f64> times(runs);
+	for (auto& time : times) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		time = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	std::nth_element(times.begin(), times.begin() + runs / 2, times.end());
+	return times[runs / 2];
+}
+
+// Middle of measurements taken elsewhere, like the renderer's frame stats
+template <typename T> T median(std::vector<T> values) {
+	std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+	return values[values.size() / 2];
+}
+
+// Stops the compiler from dropping work whose results are never read
+inline const void* volatile sink;
+inline void keep(const void* result) { sink = result; }
+
+// The job system's worker count is fixed once it starts, so a sweep over it reruns the benchmark for each count
+// with GUIDESTONE_WORKER_THREADS set. Returns true once the reruns are done, false when the count was already set
+// and this run should measure it. Counts go from one to one per core minus one, the calling thread also works.
+inline bool sweep_workers(const char* executable) {
+	if (std::getenv("GUIDESTONE_WORKER_THREADS"))
+		return false;
+
+	u32 max_workers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	for (u32 workers = 1; workers <= max_workers; workers++) {
+		setenv("GUIDESTONE_WORKER_THREADS", std::to_string(workers).c_str(), 1);
+		std::fflush(stdout);
+		if (std::system(("\"" + std::string(executable) + "\"").c_str()) != 0)
+			std::printf("%u workers failed\n", workers);
+	}
+	return true;
+}
+
+} // namespace Bench
@@ -0,0 +1,71 @@
+#include "active/input.hpp"
+#include "bench.hpp"
+#include <atomic>
+#include <memory>
+
+// 8kHz mouse movement through the input queue, against a consumer that spins for a whole frame between drains.
+// The last case stalls for longer than the queue holds, to show what is dropped.
+int main() {
+	using clock = std::chrono::steady_clock;
+	constexpr auto event_interval = std::chrono::microseconds(125);
+	constexpr auto duration = std::chrono::seconds(2);
+
+	using std::chrono::milliseconds;
+	for (auto frame : {milliseconds(16), milliseconds(100), milliseconds(1500)}) {
+		// Too big for the stack
+		auto queue = std::make_unique<SPSCQueue<Input::Event, Input::queue_capacity>>();
+		std::atomic<bool> done = false;
+		u64 pushed = 0, dropped = 0;
+		clock::duration push_time = {};
+
+		std::thread producer([&] {
+			auto next = clock::now();
+			auto end = next + duration;
+			while (next < end) {
+				next += event_interval;
+				std::this_thread::sleep_until(next);
+				Input::Event event{.type = Input::Event::Type::MouseRelative, .value = {1, 0}};
+				auto start = clock::now();
+				event.time = start;
+				if (queue->push(event))
+					pushed++;
+				else
+					dropped++;
+				push_time += clock::now() - start;
+			}
+			done = true;
+		});
+
+		u64 drained = 0, drains = 0;
+		size_t most = 0;
+		std::vector<f32> delays;
+		delays.reserve(2 * duration / event_interval);
+		auto drain = [&] {
+			auto now = clock::now();
+			size_t count = queue->drain([&](const Input::Event& event) {
+				delays.push_back(std::chrono::duration<f32, std::milli>(now - event.time).count());
+			});
+			drained += count;
+			drains++;
+			most = std::max(most, count);
+		};
+		while (!done) {
+			auto frame_end = clock::now() + frame;
+			while (clock::now() < frame_end && !done) {
+			}
+			drain();
+		}
+		producer.join();
+		drain();
+
+		std::sort(delays.begin(), delays.end());
+		f32 median = delays.empty() ? 0 : delays[delays.size() / 2];
+		f32 worst = delays.empty() ? 0 : delays.back();
+		std::printf("%lldms frames: %llu pushed, %llu dropped, %llu drained in %llu drains, %zu at most, "
+					"%.1fns per push, %.2fms median and %.2fms max until drained\n",
+					static_cast<long long>(frame.count()), static_cast<unsigned long long>(pushed),
+					static_cast<unsigned long long>(dropped), static_cast<unsigned long long>(drained),
+					static_cast<unsigned long long>(drains), most,
+					std::chrono::duration<f64, std::nano>(push_time).count() / (pushed + dropped), median, worst);
+	}
+}
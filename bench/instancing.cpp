@@ -0,0 +1,51 @@
+#include "bench.hpp"
+#include "engine.hpp"
+#include "headless.hpp"
+
+// Renders the GUIDESTONE_TEST_INSTANCES grid headless at a thousand up to fifty thousand instances, with the draws
+// built on the CPU and then on the GPU, from where the game's camera starts.
+// Reports the medians of the CPU time to record and submit a frame and of the GPU time. The collector is drawn
+// when HWC_DATA points at the game's data, otherwise a box.
+int main() {
+	// Nothing shows the frames, so don't wait on a display that isn't there
+	setenv("GUIDESTONE_PRESENT_MODE", "immediate", 0);
+	// The GPU time and the counts read back lag a few frames
+	constexpr u32 warmup_frames = 10;
+	constexpr u32 frames = 100;
+
+	for (bool gpu_culling : {false, true}) {
+		setenv("GUIDESTONE_GPU_CULLING", gpu_culling ? "1" : "0", 1);
+		auto render = Headless::create_render({1920, 1080});
+		if (!render) {
+			std::fprintf(stderr, "No Vulkan device that can render without a window\n");
+			return 1;
+		}
+
+		ModelCache cache;
+		ModelCache::index model;
+		if (std::getenv("HWC_DATA")) {
+			model = cache.loadClassicModel(Engine::test_model);
+		} else {
+			cache.materials.push_back({.texture = 0});
+			model = Headless::add_box(cache, 200, 0);
+		}
+		render->setModelCache(cache);
+
+		Camera camera = CameraSystem().main_camera;
+		for (u32 count : {1'000u, 10'000u, 50'000u}) {
+			std::vector<Render::Instance> instances = Engine::testGrid(model, count);
+			std::vector<f32> cpu_times, gpu_times;
+			for (u32 frame = 0; frame < warmup_frames + frames; frame++) {
+				render->renderFrame({.camera = camera, .instances = instances, .input_time = {}});
+				if (frame < warmup_frames)
+					continue;
+				cpu_times.push_back(render->stats().cpu_time);
+				gpu_times.push_back(render->stats().gpu_time);
+			}
+			const Render::Stats& stats = render->stats();
+			std::printf("%s draws, %u instances: %.3fms CPU submit, %.3fms GPU, %u draws, %u visible, %u culled\n",
+						gpu_culling ? "GPU" : "CPU", count, Bench::median(cpu_times), Bench::median(gpu_times),
+						stats.draws, stats.visible, stats.culled);
+		}
+	}
+}
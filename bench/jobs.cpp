@@ -0,0 +1,59 @@
+#include "bench.hpp"
+#include "jobs.hpp"
+#include <cmath>
+
+// Overhead of fine grained jobs, and how a fixed amount of work scales with the worker count
+int main(int, char** argv) {
+	if (Bench::sweep_workers(argv[0]))
+		return 0;
+	u32 threads = Jobs::worker_count() + 1;
+
+	// Empty jobs queued one at a time from outside the workers, then from inside one
+	constexpr u32 job_count = 100'000;
+	std::atomic<u32> ran = 0;
+	f64 queued = Bench::median_ms(10, [&] {
+		Jobs::Counter counter;
+		for (u32 i = 0; i < job_count; i++)
+			Jobs::run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, counter);
+		counter.wait();
+	});
+	f64 nested = Bench::median_ms(10, [&] {
+		Jobs::Counter outer;
+		Jobs::run(
+			[&ran] {
+				Jobs::Counter counter;
+				for (u32 i = 0; i < job_count; i++)
+					Jobs::run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, counter);
+				counter.wait();
+			},
+			outer);
+		outer.wait();
+	});
+	// parallel_for with one item per chunk, the smallest useful grain
+	f64 tiny_chunks = Bench::median_ms(10, [&] {
+		Jobs::parallel_for(job_count, 1, [&ran](u32 begin, u32 end) {
+			ran.fetch_add(end - begin, std::memory_order_relaxed);
+		});
+	});
+	std::printf("%u threads: %.1fns per queued job, %.1fns from a worker, %.1fns per parallel_for chunk\n", threads,
+				queued * 1e6 / job_count, nested * 1e6 / job_count, tiny_chunks * 1e6 / job_count);
+
+	// A fixed amount of arithmetic, against doing it on one thread without the job system
+	std::vector<f32> values(1 << 22);
+	auto work = [&values](u32 begin, u32 end) {
+		for (u32 i = begin; i < end; i++)
+			values[i] = std::sqrt(f32(i)) * std::sin(f32(i));
+	};
+	f64 serial = Bench::median_ms(10, [&] {
+		work(0, values.size());
+		Bench::keep(values.data());
+	});
+	for (u32 grain : {1024u, 16384u}) {
+		f64 parallel = Bench::median_ms(10, [&] {
+			Jobs::parallel_for(values.size(), grain, work);
+			Bench::keep(values.data());
+		});
+		std::printf("%u threads: %zu items in chunks of %u, %.3fms against %.3fms serial, %.2fx\n", threads,
+					values.size(), grain, parallel, serial, serial / parallel);
+	}
+}
@@ -0,0 +1,63 @@
+#include "bench.hpp"
+#include "headless.hpp"
+#include "jobs.hpp"
+#include <array>
+#include <limits>
+#include <string>
+
+// CPU time to record a frame of 256 up to 16384 draws on the CPU path, for each thread count, all in the primary
+// command buffer and split into secondaries at a few values of GUIDESTONE_MIN_DRAWS_PER_SLICE.
+// Every instance is its own model so each is a draw, and they all sit in front of the camera.
+int main(int, char** argv) {
+	if (Bench::sweep_workers(argv[0]))
+		return 0;
+
+	// Secondaries are only recorded for draws built on the CPU
+	setenv("GUIDESTONE_GPU_CULLING", "0", 1);
+	// Nothing shows the frames, so don't wait on a display that isn't there
+	setenv("GUIDESTONE_PRESENT_MODE", "immediate", 0);
+	constexpr u32 warmup_frames = 10;
+	constexpr u32 frames = 100;
+
+	constexpr std::array<u32, 5> draw_counts = {256, 1024, 4096, 8192, 16384};
+	// The first never splits the draws, the renderer defaults to 512
+	constexpr std::array<u32, 4> thresholds = {std::numeric_limits<u32>::max(), 128, 512, 2048};
+
+	ModelCache cache;
+	cache.materials.push_back({.texture = 0});
+	for (u32 i = 0; i < draw_counts.back(); i++)
+		Headless::add_box(cache, 1, 0);
+
+	std::array<std::array<f64, thresholds.size()>, draw_counts.size()> times;
+	for (size_t t = 0; t < thresholds.size(); t++) {
+		setenv("GUIDESTONE_MIN_DRAWS_PER_SLICE", std::to_string(thresholds[t]).c_str(), 1);
+		auto render = Headless::create_render({1280, 720});
+		if (!render) {
+			std::fprintf(stderr, "No Vulkan device that can render without a window\n");
+			return 1;
+		}
+		render->setModelCache(cache);
+
+		Camera camera(1000);
+		for (size_t d = 0; d < draw_counts.size(); d++) {
+			std::vector<Render::Instance> instances(draw_counts[d]);
+			for (u32 i = 0; i < instances.size(); i++)
+				instances[i].model = i;
+
+			std::vector<f32> cpu_times;
+			for (u32 frame = 0; frame < warmup_frames + frames; frame++) {
+				render->renderFrame({.camera = camera, .instances = instances, .input_time = {}});
+				if (frame >= warmup_frames)
+					cpu_times.push_back(render->stats().cpu_time);
+			}
+			times[d][t] = Bench::median(cpu_times);
+		}
+	}
+
+	u32 threads = Jobs::worker_count() + 1;
+	for (size_t d = 0; d < draw_counts.size(); d++) {
+		std::printf("%u threads, %u draws: %.3fms in one command buffer, %.3fms, %.3fms and %.3fms at least "
+					"128, 512 and 2048 per slice\n",
+					threads, draw_counts[d], times[d][0], times[d][1], times[d][2], times[d][3]);
+	}
+}
@@ -0,0 +1,41 @@
+#include "bench.hpp"
+#include "jobs.hpp"
+#include "transforms.hpp"
+
+// World matrices for 100k nodes: 10k instances of a ten node model, a short chain with a few branches
+int main(int, char** argv) {
+	if (Bench::sweep_workers(argv[0]))
+		return 0;
+
+	ModelCache cache;
+	ModelCache::Model model;
+	for (u32 n = 0; n < 10; n++) {
+		ModelCache::index parent = n == 0 ? ModelCache::index_null : n < 4 ? n - 1 : n % 4;
+		f32 angle = 0.1f * n;
+		mat4 local = mat4::fromTRS({{1, 0.5f * n, 0}, {0, 0, std::sin(angle / 2), std::cos(angle / 2)}, {1, 1, 1}});
+		model.nodes.push_back({.parent_node = parent, .transform = local});
+	}
+	cache.models.push_back(model);
+	TransformStage stage;
+	stage.setModelCache(cache);
+
+	std::vector<Render::Instance> instances(10'000);
+	for (u32 i = 0; i < instances.size(); i++) {
+		instances[i].model = 0;
+		instances[i].transform = mat4::translate({f32(i % 100), 0, f32(i / 100)});
+	}
+	std::vector<u32> bases(instances.size());
+	u32 count = 0;
+	for (u32 i = 0; i < instances.size(); i++) {
+		bases[i] = count;
+		count += stage.nodeCount(instances[i].model);
+	}
+	std::vector<mat4> world(count);
+
+	f64 ms = Bench::median_ms(50, [&] {
+		stage.evaluate(instances, bases, world.data());
+		Bench::keep(world.data());
+	});
+	std::printf("%u threads: %u nodes in %.3fms, %.2fns per node\n", Jobs::worker_count() + 1, count, ms,
+				ms * 1e6 / count);
+}
@@ -0,0 +1,38 @@
+#include "bench.hpp"
+#include "jobs.hpp"
+#include "visibility.hpp"
+#include <random>
+
+// Frustum culling 10k, 100k and 1M instances scattered around the camera, about a tenth of them in view
+int main(int, char** argv) {
+	if (Bench::sweep_workers(argv[0]))
+		return 0;
+
+	ModelCache cache;
+	ModelCache::Model model;
+	model.nodes.push_back({});
+	model.meshes.push_back({.first_vertex = 0, .num_vertices = 3, .material = 0, .node = 0, .radius = 1});
+	model.meshes.push_back(
+		{.first_vertex = 0, .num_vertices = 3, .material = 0, .node = 0, .center = {2, 0, 0}, .radius = 0.5f});
+	cache.models.push_back(model);
+	VisibilityStage stage;
+	stage.setModelCache(cache);
+
+	mat4 view = mat4::lookAt({0, 0, -10}, {0, 0, 0}, {0, 1, 0});
+	Frustum frustum = Frustum::fromMatrix(mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f) * view);
+
+	for (u32 count : {10'000u, 100'000u, 1'000'000u}) {
+		std::mt19937 rng(count);
+		std::uniform_real_distribution<f32> position(-200, 200);
+		std::vector<Render::Instance> instances(count);
+		for (auto& instance : instances) {
+			instance.model = 0;
+			instance.transform = mat4::translate({position(rng), position(rng), position(rng)});
+		}
+
+		u32 visible = 0;
+		f64 ms = Bench::median_ms(20, [&] { visible = stage.cull(instances, frustum); });
+		std::printf("%u threads: %u instances in %.3fms, %.2fns each, %u visible, %u culled\n",
+					Jobs::worker_count() + 1, count, ms, ms * 1e6 / count, visible, count - visible);
+	}
+}
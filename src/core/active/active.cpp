@@ -1,5 +1,17 @@
 #include "active.hpp"
 #include "engine.hpp"
+#include "frame_limiter.hpp"
+#include "options.hpp"
+#include "render_thread.hpp"
+
+// Falling further behind than this, e.g. after a long stall, drops ticks instead of running them all at once
+constexpr u32 max_catch_up_ticks = 4;
+
+std::chrono::steady_clock::duration interval_for(f32 fps) {
+	if (fps <= 0)
+		return std::chrono::steady_clock::duration::zero();
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<f32>(1 / fps));
+}
 
 void Active::thread_func() {
 	start_signal.acquire();
@@ -7,27 +19,103 @@ void Active::thread_func() {
 	// Not a true init step, just here for testing
 	// TODO: Move somewhere more suitable
 	engine.startGame();
+	previous_instances = instances;
+
+	// Started after the model cache is set, the render is only touched from its thread from here on
+	RenderThread render_thread(*engine.render);
+
+	using clock = std::chrono::steady_clock;
+	clock::time_point last_time = clock::now();
+	clock::duration accumulator{0};
+
+	FrameLimiter limiter;
+	bool visible = true, focused = true;
+	// Carried until the next published snapshot
+	std::optional<uvec2> resize;
+	std::optional<clock::time_point> input_time;
+	u32 frames_skipped = 0;
+	clock::duration slept{0};
 
 	while (true) {
-		{
-			const Input::State& input_state = input.get_state();
-
-			if (input_state.quit_request) {
-				engine.platform.shutdown();
-				return;
-			}
-			if (input_state.resize.has_value()) {
-				engine.render->resize(input_state.resize.value());
-			}
-
-			camera_system.main_camera.control(input_state);
-			camera_system.main_camera.set_eye_position();
+		// Nothing is drawn while hidden, but the simulation still ticks
+		clock::duration interval = !visible ? tick_length
+			: focused                       ? frame_interval
+											: std::max(frame_interval, background_interval);
+		// Before reading the input, so the frame is built from the latest
+		clock::duration waited = limiter.wait(interval);
+		if (visible)
+			slept += waited;
+
+		const Input::State& input_state = input.get_state();
+		if (!input_state.events.empty() && !input_time.has_value())
+			input_time = input_state.events.front().time;
+
+		if (input_state.quit_request) {
+			// The render is destroyed once the platform shuts down
+			render_thread.stop();
+			engine.platform.shutdown();
+			return;
+		}
+
+		// Camera control works from the input accumulated since the last frame, so it stays per frame
+		camera_system.main_camera.control(input_state);
+		camera_system.main_camera.set_eye_position();
+
+		clock::time_point now = clock::now();
+		accumulator = std::min(accumulator + (now - last_time), tick_length * max_catch_up_ticks);
+		last_time = now;
+		while (accumulator >= tick_length) {
+			tick();
+			accumulator -= tick_length;
+		}
+
+		if (input_state.resize.has_value())
+			resize = input_state.resize;
+		focused = input_state.focused;
+		if (visible != input_state.visible) {
+			visible = input_state.visible;
+			Log::info(visible ? "Window shown, rendering resumed" : "Window hidden, rendering suspended");
+		}
+		if (!visible) {
+			frames_skipped++;
+			// Nothing is shown until later, it would only measure how long the window was hidden
+			input_time.reset();
+			continue;
 		}
 
-		engine.render->renderFrame(Render::FrameInfo{camera_system.getActiveCamera()});
+		RenderThread::Snapshot& snapshot = render_thread.next();
+		snapshot.camera = camera_system.getActiveCamera();
+		snapshot.input_time = input_time;
+		// Snapshots are recycled, the tick state only needs copying when it has moved on
+		if (snapshot.tick != tick_count) {
+			snapshot.previous_instances.assign(previous_instances.begin(), previous_instances.end());
+			snapshot.instances.assign(instances.begin(), instances.end());
+			snapshot.tick = tick_count;
+		}
+		snapshot.blend = std::chrono::duration<f32>(accumulator) / tick_length;
+		snapshot.resize = resize;
+		snapshot.frames_skipped = frames_skipped;
+		snapshot.sleep_time = std::chrono::duration<f32, std::milli>(slept).count();
+		render_thread.publish();
+		resize.reset();
+		input_time.reset();
+		frames_skipped = 0;
+		slept = clock::duration::zero();
 	}
 }
 
-Active::Active(Engine& e) : engine(e), input(e) { thread = std::thread(&Active::thread_func, this); }
+void Active::tick() {
+	previous_instances.assign(instances.begin(), instances.end());
+	tick_count++;
+}
+
+Active::Active(Engine& e)
+	: engine(e),
+	  tick_length(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		  std::chrono::duration<f32>(1 / Options::get("tick_rate", 16.0f)))),
+	  frame_interval(interval_for(Options::get("fps_cap", 0.0f))),
+	  background_interval(interval_for(Options::get("background_fps_cap", 30.0f))), input(e) {
+	thread = std::thread(&Active::thread_func, this);
+}
 void Active::start() { start_signal.release(); }
 Active::~Active() { thread.join(); }
@@ -2,6 +2,8 @@
 
 #include "camera.hpp"
 #include "input.hpp"
+#include "render.hpp"
+#include <chrono>
 #include <thread>
 
 class Engine;
@@ -13,6 +15,15 @@ class Active {
 	void thread_func();
 	std::binary_semaphore start_signal{0};
 
+	// The simulation advances in fixed ticks, independent of the frame rate
+	std::chrono::steady_clock::duration tick_length;
+	u64 tick_count = 0;
+	void tick();
+
+	// Zero for no cap, the background cap applies while the window isn't focused
+	std::chrono::steady_clock::duration frame_interval;
+	std::chrono::steady_clock::duration background_interval;
+
   public:
 	Active(Engine&);
 	void start();
@@ -20,4 +31,7 @@ class Active {
 
 	Input input;
 	CameraSystem camera_system;
+	// State after the latest tick, and the one before it, which frames are interpolated between
+	std::vector<Render::Instance> instances;
+	std::vector<Render::Instance> previous_instances;
 };
@@ -0,0 +1,23 @@
+#include "frame_limiter.hpp"
+
+#include <thread>
+
+// Longer than sleeps usually overshoot by
+constexpr std::chrono::milliseconds spin_time(2);
+
+FrameLimiter::clock::duration FrameLimiter::wait(clock::duration interval) {
+	clock::time_point start = clock::now();
+	clock::time_point target = last + interval;
+	// A late frame starts the schedule over, rather than the next few running back to back to catch up
+	if (start >= target) {
+		last = start;
+		return clock::duration::zero();
+	}
+
+	if (target - start > spin_time)
+		std::this_thread::sleep_until(target - spin_time);
+	while (clock::now() < target)
+		std::this_thread::yield();
+	last = target;
+	return clock::now() - start;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <chrono>
+
+// Holds frames to a fixed interval. Most of each wait is slept, but sleeps can overshoot by a millisecond or more,
+// so the end of it is spun instead.
+class FrameLimiter {
+	using clock = std::chrono::steady_clock;
+
+	clock::time_point last = clock::now();
+
+  public:
+	// Returns how long it waited, an interval of zero doesn't wait at all
+	clock::duration wait(clock::duration interval);
+};
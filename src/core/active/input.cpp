@@ -1,5 +1,46 @@
 #include "input.hpp"
 #include "engine.hpp"
+#include "log.hpp"
+
+const Input::State& Input::get_state() {
+	state.quit_request = quit.load(std::memory_order_relaxed);
+	state.visible = visible.load(std::memory_order_relaxed);
+	state.focused = focused.load(std::memory_order_relaxed);
+	state.resize.reset();
+	if (u64 size = resized.exchange(0, std::memory_order_relaxed))
+		state.resize = uvec2{static_cast<u32>(size >> 32) & ~u32(resize_pending >> 32), static_cast<u32>(size)};
+	state.mouse_relative = {0, 0};
+	state.scroll = 0;
+	state.events.clear();
+
+	queue.drain([this](const Event& event) {
+		switch (event.type) {
+		case Event::Type::MouseRelative:
+			state.mouse_relative += event.value;
+			break;
+		case Event::Type::MousePosition:
+			state.mouse_position = event.value;
+			break;
+		case Event::Type::MouseLeave:
+			state.mouse_position.reset();
+			break;
+		case Event::Type::Scroll:
+			state.scroll += event.value.x;
+			break;
+		// Taken from the atomics above, the events are only passed on
+		case Event::Type::Resize:
+		case Event::Type::Visible:
+		case Event::Type::Focus:
+			break;
+		}
+		state.events.push_back(event);
+	});
+
+	if (u32 lost = dropped.exchange(0, std::memory_order_relaxed)) {
+		Log::warn("Input queue full", std::to_string(lost) + " events dropped");
+	}
+	return state;
+}
 
 void Input::mouse_button(MouseButton button, bool pressed) {
 	if (button == MouseButton::Right) {
@@ -1,64 +1,101 @@
 #pragma once
 
 #include "math.hpp"
+#include "spsc_queue.hpp"
 #include "types.hpp"
-#include <array>
-#include <mutex>
+#include <atomic>
+#include <chrono>
 #include <optional>
+#include <vector>
 
 class Engine;
 
+// Input from the platform thread, read by the simulation once per frame.
+// Every event is timestamped and passed through a lock free queue, so a high rate mouse doesn't contend
+// with the simulation, and the order and timing within a frame is kept.
+// The queue drops events when full, so anything that must not be lost is also kept in atomics beside it.
 class Input {
 	Engine& engine;
 
   public:
+	struct Event {
+		enum class Type : u8 { MouseRelative, MousePosition, MouseLeave, Scroll, Resize, Visible, Focus };
+		Type type;
+		std::chrono::steady_clock::time_point time = {};
+		// Mouse movement, or the scroll in x
+		vec2 value = {0, 0};
+		uvec2 size = {0, 0};
+		bool flag = false;
+	};
+
+	// Everything since the last get_state, coalesced
 	struct State {
 		bool quit_request = false;
 		std::optional<uvec2> resize;
 		std::optional<vec2> mouse_position;
 		vec2 mouse_relative = {0, 0};
 		f32 scroll = 0.0;
+		// These carry over until the window changes, unlike the events above
+		bool visible = true;
+		bool focused = true;
+		// In the order they arrived, for anything that wants them at their own times
+		std::vector<Event> events;
 	};
 
+	// Over a second of 8kHz mouse movement, frames are far shorter than that
+	static constexpr size_t queue_capacity = 8192;
+
   private:
-	std::mutex state_mutex;
-	std::array<State, 2> state;
-	size_t active_state = 0;
+	SPSCQueue<Event, queue_capacity> queue;
+	// Outside the queue, so they are never lost to it being full
+	// Only the latest of each matters, a lost hide or show would stop or never resume rendering
+	std::atomic<bool> quit = false;
+	std::atomic<bool> visible = true;
+	std::atomic<bool> focused = true;
+	// The latest size, with the top bit set until the simulation has taken it
+	std::atomic<u64> resized = 0;
+	static constexpr u64 resize_pending = u64(1) << 63;
+	std::atomic<u32> dropped = 0;
+	State state;
+
+	void push(Event event) {
+		event.time = std::chrono::steady_clock::now();
+		if (!queue.push(event))
+			dropped.fetch_add(1, std::memory_order_relaxed);
+	}
 
   public:
 	Input(Engine& e) : engine(e) {}
 
-	const State& get_state() {
-		std::unique_lock lock(state_mutex);
-		const State& ret = state[active_state];
-		active_state = (active_state + 1) % state.size();
-		state[active_state] = State();
-		state[active_state].mouse_position = ret.mouse_position;
-		return ret;
+	// Simulation thread only, valid until it is called again
+	const State& get_state();
+
+	// Platform thread only
+	void quit_request() { quit.store(true, std::memory_order_relaxed); }
+	void resize(uvec2 size) {
+		resized.store(resize_pending | u64(size.x) << 32 | size.y, std::memory_order_relaxed);
+		push({.type = Event::Type::Resize, .size = size});
 	}
 
-	void quit_request() {
-		std::unique_lock lock(state_mutex);
-		state[active_state].quit_request = true;
+	// Minimised or hidden windows aren't drawn to
+	void window_visible(bool shown) {
+		visible.store(shown, std::memory_order_relaxed);
+		push({.type = Event::Type::Visible, .flag = shown});
 	}
-	void resize(uvec2 size) {
-		std::unique_lock lock(state_mutex);
-		state[active_state].resize = size;
+	void window_focus(bool focus) {
+		focused.store(focus, std::memory_order_relaxed);
+		push({.type = Event::Type::Focus, .flag = focus});
 	}
 
 	enum class MouseButton { Left, Right, Middle };
 	void mouse_button(MouseButton button, bool pressed);
 
 	void mouse_position(std::optional<vec2> pos) {
-		std::unique_lock lock(state_mutex);
-		state[active_state].mouse_position = pos;
-	}
-	void mouse_relative(vec2 rel) {
-		std::unique_lock lock(state_mutex);
-		state[active_state].mouse_relative += rel;
-	}
-	void mouse_scroll(f32 scroll) {
-		std::unique_lock lock(state_mutex);
-		state[active_state].scroll += scroll;
+		if (pos.has_value())
+			push({.type = Event::Type::MousePosition, .value = pos.value()});
+		else
+			push({.type = Event::Type::MouseLeave});
 	}
+	void mouse_relative(vec2 rel) { push({.type = Event::Type::MouseRelative, .value = rel}); }
+	void mouse_scroll(f32 scroll) { push({.type = Event::Type::Scroll, .value = {scroll, 0}}); }
 };
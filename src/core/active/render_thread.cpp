@@ -0,0 +1,84 @@
+#include "render_thread.hpp"
+
+#include "allocations.hpp"
+#include "log.hpp"
+
+// Frames after this shouldn't allocate, unless something like the window size or instance count changed
+constexpr u64 warm_up_frames = 100;
+
+RenderThread::RenderThread(Render& r) : render(r) { thread = std::thread(&RenderThread::thread_func, this); }
+
+void RenderThread::publish() {
+	// Nothing takes snapshots anymore, releasing again could overflow published
+	if (stopping)
+		return;
+
+	if (!taken.try_acquire()) {
+		simulation_waits++;
+		taken.acquire();
+	}
+	back = shared.exchange(back);
+	published.release();
+}
+
+void RenderThread::stop() {
+	if (!thread.joinable())
+		return;
+
+	stopping = true;
+	// A snapshot may already be published and not yet picked up. Only this thread releases published,
+	// so clearing it first keeps the count at most one
+	(void)published.try_acquire();
+	published.release();
+	thread.join();
+}
+
+void RenderThread::thread_func() {
+	while (true) {
+		bool waited = false;
+		if (!published.try_acquire()) {
+			waited = true;
+			published.acquire();
+		}
+		if (stopping)
+			return;
+
+		front = shared.exchange(front);
+		taken.release();
+
+		const Snapshot& snapshot = snapshots[front];
+		if (snapshot.resize.has_value()) {
+			render.resize(snapshot.resize.value());
+		}
+
+		std::span<const Render::Instance> instances = snapshot.instances;
+		// Instances are matched up by index, so there is nothing to blend when the count changed
+		if (snapshot.blend < 1 && snapshot.previous_instances.size() == snapshot.instances.size()) {
+			blended.assign(snapshot.instances.begin(), snapshot.instances.end());
+			for (size_t i = 0; i < blended.size(); i++) {
+				blended[i].transform =
+					lerp(snapshot.previous_instances[i].transform, snapshot.instances[i].transform, snapshot.blend);
+			}
+			instances = blended;
+		}
+		u64 allocations = Allocations::count();
+		render.renderFrame(Render::FrameInfo{snapshot.camera, instances, snapshot.input_time});
+		allocations = Allocations::count() - allocations;
+		// Only the first, the stats log counts the rest
+		if (allocations && frames >= warm_up_frames && !warned_allocation) {
+			Log::warn(
+				"Frame allocated on the heap",
+				std::to_string(allocations) + " allocations in frame " + std::to_string(frames));
+			warned_allocation = true;
+		}
+		frames++;
+
+		Render::Stats stats = render.stats();
+		stats.allocations = allocations;
+		stats.render_waits = waited;
+		stats.simulation_waits = simulation_waits.exchange(0);
+		stats.frames_skipped = snapshot.frames_skipped;
+		stats.sleep_time = snapshot.sleep_time;
+		stats_log.frame(stats);
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "camera.hpp"
+#include "render.hpp"
+#include "stats.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+// Submits frames on its own thread, so GPU back pressure doesn't stall the simulation
+// and a slow simulation tick doesn't hold up presenting.
+//
+// The simulation fills in a snapshot and publishes it through a triple buffer: one snapshot is being written,
+// one is being rendered and the third is handed between them by swapping an index. The simulation only waits
+// when the snapshot it published last hasn't been picked up yet, so it runs at most one frame ahead.
+class RenderThread {
+  public:
+	// Everything a frame needs, copied so the simulation can carry on while it renders
+	struct Snapshot {
+		Camera camera{0};
+		std::optional<std::chrono::steady_clock::time_point> input_time;
+		// The last two simulation ticks, instance transforms are interpolated between them by blend
+		std::vector<Render::Instance> previous_instances;
+		std::vector<Render::Instance> instances;
+		u64 tick = std::numeric_limits<u64>::max();
+		f32 blend = 1;
+		std::optional<uvec2> resize;
+		// Since the last snapshot was published
+		u32 frames_skipped = 0;
+		f32 sleep_time = 0;
+	};
+
+  private:
+	Render& render;
+
+	std::array<Snapshot, 3> snapshots;
+	u32 back = 0;
+	std::atomic<u32> shared = 1;
+	u32 front = 2;
+
+	std::binary_semaphore published{0};
+	std::binary_semaphore taken{1};
+	std::atomic<bool> stopping = false;
+	// Reset every frame when the stats are gathered
+	std::atomic<u32> simulation_waits = 0;
+
+	// Reused every frame
+	std::vector<Render::Instance> blended;
+	u64 frames = 0;
+	bool warned_allocation = false;
+
+	StatsLog stats_log;
+
+	std::thread thread;
+	void thread_func();
+
+  public:
+	RenderThread(const RenderThread&) = delete;
+	RenderThread(Render&);
+	~RenderThread() { stop(); }
+
+	// The snapshot the simulation fills in next, only valid until publish
+	Snapshot& next() { return snapshots[back]; }
+	void publish();
+
+	// Finishes the frame in progress, the render can be destroyed afterwards. Must be called from the thread
+	// that publishes, later snapshots are dropped
+	void stop();
+};
@@ -0,0 +1,36 @@
+#include "allocations.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local u64 allocations = 0;
+
+} // namespace
+
+u64 Allocations::count() { return allocations; }
+
+#ifndef NDEBUG
+
+// The array and nothrow forms all end up here
+void* operator new(std::size_t size) {
+	allocations++;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+	allocations++;
+	std::size_t alignment = static_cast<std::size_t>(align);
+	if (void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+#endif
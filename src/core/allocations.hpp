@@ -0,0 +1,19 @@
+#pragma once
+
+#include "types.hpp"
+
+// Counts heap allocations per thread, so loops that should have stopped allocating once warmed up can check.
+// Only debug builds replace operator new to count them, release builds always report zero.
+namespace Allocations {
+
+// Made by the calling thread so far
+u64 count();
+constexpr bool counted() {
+#ifdef NDEBUG
+	return false;
+#else
+	return true;
+#endif
+}
+
+} // namespace Allocations
@@ -0,0 +1,30 @@
+#include "arena.hpp"
+
+#include <bit>
+
+Arena::Arena(size_t initial_capacity) : capacity(initial_capacity) {
+	if (capacity)
+		block = std::make_unique_for_overwrite<std::byte[]>(capacity);
+}
+
+std::byte* Arena::allocate_bytes(size_t size, size_t alignment) {
+	size_t offset = (used + alignment - 1) & ~(alignment - 1);
+	if (offset + size <= capacity) {
+		used = offset + size;
+		return block.get() + offset;
+	}
+	// new[] aligns for any fundamental type
+	overflow.push_back(std::make_unique_for_overwrite<std::byte[]>(size));
+	overflow_size += size + alignof(std::max_align_t);
+	return overflow.back().get();
+}
+
+void Arena::reset() {
+	if (!overflow.empty()) {
+		capacity = std::bit_ceil(capacity + overflow_size);
+		block = std::make_unique_for_overwrite<std::byte[]>(capacity);
+		overflow.clear();
+		overflow_size = 0;
+	}
+	used = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "types.hpp"
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for data that only lives until the next reset, e.g. one frame.
+// Running out allocates another block for the rest, and the next reset replaces them all with one block big
+// enough for everything, so once the usage settles it stops allocating at all.
+class Arena {
+	std::unique_ptr<std::byte[]> block;
+	size_t capacity = 0;
+	size_t used = 0;
+	// What didn't fit since the last reset
+	std::vector<std::unique_ptr<std::byte[]>> overflow;
+	size_t overflow_size = 0;
+
+	std::byte* allocate_bytes(size_t size, size_t alignment);
+
+  public:
+	Arena(size_t initial_capacity = 0);
+
+	// Nothing is destroyed, so only for types that don't need it
+	template <typename T> std::span<T> allocate(size_t count) {
+		static_assert(std::is_trivially_destructible_v<T> && alignof(T) <= alignof(std::max_align_t));
+		T* items = reinterpret_cast<T*>(allocate_bytes(count * sizeof(T), alignof(T)));
+		std::uninitialized_value_construct_n(items, count);
+		return {items, count};
+	}
+	// Everything allocated since the last reset is freed
+	void reset();
+};
@@ -1,6 +1,7 @@
 #include "engine.hpp"
 
 #include "model.hpp"
+#include "options.hpp"
 
 Engine::Engine(Platform& p) : platform(p), active(*this) {}
 
@@ -12,6 +13,24 @@ void Engine::init() {
 
 void Engine::startGame() {
 	ModelCache model_cache;
-	model_cache.loadClassicModel("r1/resourcecollector/rl0/lod0/resourcecollector.peo");
+	ModelCache::index collector = model_cache.loadClassicModel(test_model);
 	render->setModelCache(model_cache);
+
+	active.instances = testGrid(collector, Options::get<u32>("test_instances", 1));
+}
+
+std::vector<Render::Instance> Engine::testGrid(ModelCache::index model, u32 count) {
+	u32 side = std::ceil(std::sqrt(static_cast<f32>(count)));
+	constexpr f32 spacing = 400;
+	std::vector<Render::Instance> instances;
+	instances.reserve(count);
+	for (u32 i = 0; i < count; i++) {
+		vec3 pos = {
+			(static_cast<f32>(i % side) - static_cast<f32>(side - 1) / 2) * spacing,
+			(static_cast<f32>(i / side) - static_cast<f32>(side - 1) / 2) * spacing,
+			0,
+		};
+		instances.push_back({.model = model, .transform = mat4::translate(pos), .team = i % 2});
+	}
+	return instances;
 }
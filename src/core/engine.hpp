@@ -21,4 +21,9 @@ class Engine {
 	void init();
 	~Engine() {}
 	void startGame();
+
+	// Test scene, a square grid of collectors centred on the origin, sized by GUIDESTONE_TEST_INSTANCES
+	// The benchmarks render the same grid
+	static constexpr const char* test_model = "r1/resourcecollector/rl0/lod0/resourcecollector.peo";
+	static std::vector<Render::Instance> testGrid(ModelCache::index model, u32 count);
 };
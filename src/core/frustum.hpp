@@ -0,0 +1,33 @@
+#pragma once
+
+#include "math.hpp"
+#include "types.hpp"
+
+struct Frustum {
+	// Left, right, bottom, top, near, far
+	// xyz is the inwards facing normal and w the distance, so inside points give a positive dot product
+	vec4 planes[6];
+
+	// Extracts the planes from a projection * view matrix, with Vulkan depth
+	// The far plane of mat4::perspective is at infinity, and comes out as a plane every point is inside
+	static Frustum fromMatrix(const mat4& m) {
+		auto row = [&m](int r) { return vec4{m[0][r], m[1][r], m[2][r], m[3][r]}; };
+		vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+
+		Frustum f{{w + x, w - x, w + y, w - y, w - z, z}};
+		for (auto& p : f.planes) {
+			f32 len = length(vec3{p.x, p.y, p.z});
+			if (len > 0)
+				p /= len;
+		}
+		return f;
+	}
+
+	bool containsSphere(vec3 center, f32 radius) const {
+		for (auto& p : planes) {
+			if (dot(vec3{p.x, p.y, p.z}, center) + p.w < -radius)
+				return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,198 @@
+#include "jobs.hpp"
+
+#include "options.hpp"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <thread>
+
+namespace Jobs {
+
+namespace {
+
+// A ring that only grows, unlike a deque it doesn't allocate as jobs come and go
+struct Queue {
+	std::mutex mutex;
+	std::vector<Job> jobs;
+	size_t first = 0, size = 0;
+
+	void push_back(Job job) {
+		if (size == jobs.size()) {
+			std::vector<Job> grown(std::max<size_t>(jobs.size() * 2, 64));
+			for (size_t i = 0; i < size; i++)
+				grown[i] = std::move(at(i));
+			jobs.swap(grown);
+			first = 0;
+		}
+		at(size++) = std::move(job);
+	}
+	Job pop_back() { return std::exchange(at(--size), nullptr); }
+	Job pop_front() {
+		Job job = std::exchange(at(0), nullptr);
+		first = (first + 1) % jobs.size();
+		size--;
+		return job;
+	}
+	Job& at(size_t i) { return jobs[(first + i) % jobs.size()]; }
+};
+
+// Which queue the current thread owns, threads that aren't workers use the shared one
+thread_local u32 local_index = std::numeric_limits<u32>::max();
+
+class Scheduler {
+	const u32 count;
+	// One per worker, then the shared one
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	// Bumped whenever a job is queued, idle workers sleep until it changes
+	std::atomic<u32> epoch = 0;
+	std::atomic<bool> stopping = false;
+
+	void worker_func(u32 index) {
+		local_index = index;
+		while (!stopping) {
+			u32 seen = epoch.load(std::memory_order_acquire);
+			if (!run_one())
+				epoch.wait(seen, std::memory_order_acquire);
+		}
+	}
+
+  public:
+	Scheduler()
+		: count(std::max(Options::get("worker_threads", std::max(std::thread::hardware_concurrency(), 2u) - 1), 1u)) {
+		for (u32 i = 0; i <= count; i++)
+			queues.push_back(std::make_unique<Queue>());
+		for (u32 i = 0; i < count; i++)
+			workers.emplace_back(&Scheduler::worker_func, this, i);
+	}
+	~Scheduler() {
+		stopping = true;
+		epoch++;
+		epoch.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	u32 worker_count() const { return count; }
+
+	void push(Job job) {
+		Queue& queue = *queues[std::min(local_index, count)];
+		{
+			std::lock_guard lock(queue.mutex);
+			queue.push_back(std::move(job));
+		}
+		epoch.fetch_add(1, std::memory_order_release);
+		epoch.notify_one();
+	}
+
+	// Newest first from our own queue, otherwise the oldest job from someone else's
+	bool run_one() {
+		Job job;
+		if (local_index < count) {
+			Queue& own = *queues[local_index];
+			std::lock_guard lock(own.mutex);
+			if (own.size)
+				job = own.pop_back();
+		}
+		for (u32 i = 0; !job && i <= count; i++) {
+			Queue& victim = *queues[(std::min(local_index, count) + i) % (count + 1)];
+			std::lock_guard lock(victim.mutex);
+			if (victim.size)
+				job = victim.pop_front();
+		}
+		if (!job)
+			return false;
+
+		job();
+		return true;
+	}
+};
+
+Scheduler& scheduler() {
+	static Scheduler instance;
+	return instance;
+}
+
+} // namespace
+
+void Counter::add(u32 n) { count.fetch_add(n, std::memory_order_relaxed); }
+
+void Counter::done() {
+	std::vector<Job> ready;
+	{
+		// Held while reaching zero, so wait() can't return and destroy the counter under us
+		std::lock_guard lock(mutex);
+		if (count.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+		ready.swap(continuations);
+		count.notify_all();
+	}
+	for (Job& job : ready)
+		run(std::move(job));
+}
+
+void Counter::then(Job job) {
+	{
+		std::lock_guard lock(mutex);
+		if (count.load(std::memory_order_acquire) != 0) {
+			continuations.push_back(std::move(job));
+			return;
+		}
+	}
+	run(std::move(job));
+}
+
+void Counter::wait() {
+	while (true) {
+		u32 remaining = count.load(std::memory_order_acquire);
+		if (remaining == 0)
+			break;
+		if (!scheduler().run_one())
+			count.wait(remaining, std::memory_order_acquire);
+	}
+	// The last done() may not have let go yet
+	std::lock_guard lock(mutex);
+}
+
+void run(Job job) { scheduler().push(std::move(job)); }
+
+void run(Job job, Counter& counter) {
+	counter.add();
+	scheduler().push([job = std::move(job), &counter] {
+		job();
+		counter.done();
+	});
+}
+
+void parallel_for(u32 count, u32 grain, void (*call)(const void* f, u32 begin, u32 end), const void* f) {
+	grain = std::max(grain, 1u);
+	if (count <= grain) {
+		call(f, 0, count);
+		return;
+	}
+
+	Counter counter;
+	counter.add((count - 1) / grain);
+	auto chunk = [&](u32 begin) {
+		call(f, begin, std::min(begin + grain, count));
+		counter.done();
+	};
+	// Only a pointer and an index, small enough for std::function to hold without allocating
+	for (u32 begin = grain; begin < count; begin += grain) {
+		scheduler().push([&chunk, begin] { chunk(begin); });
+	}
+	call(f, 0, grain);
+	counter.wait();
+}
+
+u32 worker_count() { return scheduler().worker_count(); }
+
+void spawn(Task task, Counter& counter) {
+	counter.add();
+	auto handle = std::exchange(task.handle, {});
+	handle.promise().counter = &counter;
+	run([handle] { handle.resume(); });
+}
+
+} // namespace Jobs
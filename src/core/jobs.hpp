@@ -0,0 +1,99 @@
+#pragma once
+
+#include "types.hpp"
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Work stealing job system shared by the engine subsystems
+//
+// Each worker thread has its own queue, a ring guarded by a mutex rather than a lock free deque. The owner pushes
+// and pops jobs at the back, and idle workers steal the oldest from the front of the others, so the mutex is
+// only contended while stealing. Threads that aren't workers queue into a shared one that every worker takes from.
+// Waiting on a counter runs other jobs in the meantime, so jobs can wait on jobs without tying up a worker.
+//
+// Workers are started the first time a job is queued, one per core minus one unless GUIDESTONE_WORKER_THREADS
+// says otherwise.
+namespace Jobs {
+
+using Job = std::function<void()>;
+
+// Counts outstanding jobs. Continuations queued with then() run once it reaches zero.
+// Coroutine tasks can co_await a counter, e.g. one signalled by a job loading a file.
+class Counter {
+	std::atomic<u32> count = 0;
+	std::mutex mutex;
+	std::vector<Job> continuations;
+
+  public:
+	Counter() = default;
+	Counter(const Counter&) = delete;
+
+	void add(u32 n = 1);
+	void done();
+	bool finished() const { return count.load(std::memory_order_acquire) == 0; }
+
+	// Queues the job once the counter reaches zero, straight away if it already has
+	void then(Job);
+	// Runs other jobs until the counter reaches zero
+	void wait();
+
+	bool await_ready() const { return finished(); }
+	void await_suspend(std::coroutine_handle<> handle) {
+		then([handle] { handle.resume(); });
+	}
+	void await_resume() const {}
+};
+
+// Queues a job, the counter is signalled once it has run
+void run(Job);
+void run(Job, Counter&);
+
+// Calls f(begin, end) over [0, count) in chunks of grain, spread across the workers and the calling thread
+// f is passed through as a pointer, a std::function of a lambda capturing much would allocate every call
+void parallel_for(u32 count, u32 grain, void (*call)(const void* f, u32 begin, u32 end), const void* f);
+template <typename F> void parallel_for(u32 count, u32 grain, const F& f) {
+	parallel_for(
+		count, grain, [](const void* f, u32 begin, u32 end) { (*static_cast<const F*>(f))(begin, end); }, &f);
+}
+
+u32 worker_count();
+
+// A coroutine run on the workers. It starts once spawned and signals the counter when it returns.
+class Task {
+  public:
+	struct promise_type {
+		Counter* counter = nullptr;
+
+		Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		// Locals are already gone here, so whoever waits on the counter can't see them destroyed late
+		std::suspend_never final_suspend() noexcept {
+			if (counter)
+				counter->done();
+			return {};
+		}
+		void return_void() {}
+		// Like an exception escaping a thread
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	Task(Task&& o) : handle(std::exchange(o.handle, {})) {}
+	~Task() {
+		if (handle)
+			handle.destroy();
+	}
+
+  private:
+	explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+	std::coroutine_handle<promise_type> handle;
+	friend void spawn(Task, Counter&);
+};
+
+void spawn(Task, Counter&);
+
+} // namespace Jobs
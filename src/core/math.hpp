@@ -1,5 +1,6 @@
 #pragma once
 
+#include "simd.hpp"
 #include "types.hpp"
 #include <cmath>
 #include <numbers>
@@ -10,6 +11,14 @@ template <typename T> consteval T degToRad(T deg) {
 }
 
 // All angles are radians
+// f32 Vector4 and Matrix4 are aligned and do their arithmetic in SIMD registers, other types stay scalar
+
+// Defining GUIDESTONE_SCALAR_MATH keeps f32 on the scalar templates too, the math test checks the two agree
+#ifdef GUIDESTONE_SCALAR_MATH
+constexpr bool simd_math = false;
+#else
+constexpr bool simd_math = true;
+#endif
 
 template <typename T = f32> struct Vector2 {
 	static_assert(std::is_arithmetic_v<T>);
@@ -17,6 +26,7 @@ template <typename T = f32> struct Vector2 {
 	T x = 0, y = 0;
 
 	T& operator[](int axis) { return ((T*)this)[axis]; }
+	const T& operator[](int axis) const { return ((const T*)this)[axis]; }
 
 	template <typename R> explicit operator Vector2<R>() { return {static_cast<R>(x), static_cast<R>(y)}; }
 
@@ -52,7 +62,23 @@ template <typename T = f32> struct Vector3 {
 
 	T x = 0, y = 0, z = 0;
 
+	// Loaded with w = 0, which keeps dot products and cross products of three components
+	static constexpr bool simd = simd_math && std::is_same_v<T, f32>;
+	SIMD::f32x4 toSIMD() const
+		requires simd
+	{
+		return SIMD::f32x4::set(x, y, z, 0);
+	}
+	static Vector3 fromSIMD(SIMD::f32x4 v)
+		requires simd
+	{
+		f32 r[4];
+		v.store(r);
+		return {r[0], r[1], r[2]};
+	}
+
 	T& operator[](int axis) { return ((T*)this)[axis]; }
+	const T& operator[](int axis) const { return ((const T*)this)[axis]; }
 
 	template <typename R> explicit operator Vector3<R>() {
 		return {static_cast<R>(x), static_cast<R>(y), static_cast<R>(z)};
@@ -76,7 +102,11 @@ template <typename T = f32> struct Vector3 {
 
 	friend inline T dot(const Vector3& a, const Vector3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
 	friend inline Vector3 cross(const Vector3& a, const Vector3& b) {
-		return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+		if constexpr (simd) {
+			return fromSIMD(SIMD::cross(a.toSIMD(), b.toSIMD()));
+		} else {
+			return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+		}
 	}
 
 	friend inline T lengthSquared(const Vector3& v) { return v.x * v.x + v.y * v.y + v.z * v.z; }
@@ -88,12 +118,27 @@ using fvec3 = Vector3<f32>;
 using u8vec3 = Vector3<u8>;
 using vec3 = fvec3;
 
-template <typename T = f32> struct Vector4 {
+template <typename T = f32> struct alignas(std::is_same_v<T, f32> ? 16 : alignof(T)) Vector4 {
 	static_assert(std::is_arithmetic_v<T>);
 
 	T x = 0, y = 0, z = 0, w = 0;
 
+	static constexpr bool simd = simd_math && std::is_same_v<T, f32>;
+	SIMD::f32x4 toSIMD() const
+		requires simd
+	{
+		return SIMD::f32x4::load(&x);
+	}
+	static Vector4 fromSIMD(SIMD::f32x4 v)
+		requires simd
+	{
+		Vector4 r;
+		v.store(&r.x);
+		return r;
+	}
+
 	T& operator[](int axis) { return ((T*)this)[axis]; }
+	const T& operator[](int axis) const { return ((const T*)this)[axis]; }
 
 	template <typename R> explicit operator Vector4<R>() {
 		return {static_cast<R>(x), static_cast<R>(y), static_cast<R>(z), static_cast<R>(w)};
@@ -105,33 +150,56 @@ template <typename T = f32> struct Vector4 {
 		return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
 	}
 
-	friend inline Vector4 operator*(const Vector4& v, T s) { return {v.x * s, v.y * s, v.z * s, v.w * s}; }
-	friend inline Vector4 operator/(const Vector4& v, T s) { return {v.x / s, v.y / s, v.z / s, v.w / s}; }
+	friend inline Vector4 operator*(const Vector4& v, T s) {
+		if constexpr (simd)
+			return fromSIMD(v.toSIMD() * SIMD::f32x4::splat(s));
+		else
+			return {v.x * s, v.y * s, v.z * s, v.w * s};
+	}
+	friend inline Vector4 operator/(const Vector4& v, T s) {
+		if constexpr (simd)
+			return fromSIMD(v.toSIMD() / SIMD::f32x4::splat(s));
+		else
+			return {v.x / s, v.y / s, v.z / s, v.w / s};
+	}
 	friend inline Vector4 operator+(const Vector4& a, const Vector4& b) {
-		return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+		if constexpr (simd)
+			return fromSIMD(a.toSIMD() + b.toSIMD());
+		else
+			return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
 	}
 	friend inline Vector4 operator-(const Vector4& a, const Vector4& b) {
-		return {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
+		if constexpr (simd)
+			return fromSIMD(a.toSIMD() - b.toSIMD());
+		else
+			return {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
 	}
 	friend inline Vector4 operator*(const Vector4& a, const Vector4& b) {
-		return {a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w};
+		if constexpr (simd)
+			return fromSIMD(a.toSIMD() * b.toSIMD());
+		else
+			return {a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w};
 	}
 	friend inline Vector4 operator/(const Vector4& a, const Vector4& b) {
-		return {a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w};
+		if constexpr (simd)
+			return fromSIMD(a.toSIMD() / b.toSIMD());
+		else
+			return {a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w};
 	}
 
-	friend inline Vector4 operator*=(Vector4& v, T s) { return {v.x *= s, v.y *= s, v.z *= s, v.w *= s}; }
-	friend inline Vector4 operator/=(Vector4& v, T s) { return {v.x /= s, v.y /= s, v.z /= s, v.w /= s}; }
-	friend inline Vector4 operator+=(Vector4& a, const Vector4& b) {
-		return {a.x += b.x, a.y += b.y, a.z += b.z, a.w += b.w};
-	}
-	friend inline Vector4 operator-=(Vector4& a, const Vector4& b) {
-		return {a.x -= b.x, a.y -= b.y, a.z -= b.z, a.w -= b.w};
-	}
+	friend inline Vector4 operator*=(Vector4& v, T s) { return v = v * s; }
+	friend inline Vector4 operator/=(Vector4& v, T s) { return v = v / s; }
+	friend inline Vector4 operator+=(Vector4& a, const Vector4& b) { return a = a + b; }
+	friend inline Vector4 operator-=(Vector4& a, const Vector4& b) { return a = a - b; }
 
-	friend inline T dot(const Vector4& a, const Vector4 b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+	friend inline T dot(const Vector4& a, const Vector4 b) {
+		if constexpr (simd)
+			return SIMD::dot(a.toSIMD(), b.toSIMD());
+		else
+			return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	}
 
-	friend inline T lengthSquared(const Vector4& v) { return v.x * v.x + v.y * v.y + v.z * v.z + v.w * v.w; }
+	friend inline T lengthSquared(const Vector4& v) { return dot(v, v); }
 
 	template <typename R> friend R& operator>>(R& r, Vector4& v) { return r >> v.x >> v.y >> v.z >> v.w; }
 };
@@ -140,13 +208,18 @@ using fvec4 = Vector4<f32>;
 using u8vec4 = Vector4<u8>;
 using vec4 = fvec4;
 
-template <typename V> auto length(const V& v) { return sqrt(lengthSquared(v)); }
+template <typename V> auto length(const V& v) { return std::sqrt(lengthSquared(v)); }
+template <typename V, typename T> V lerp(const V& a, const V& b, T t) { return a + (b - a) * t; }
 template <typename V> V normalized(const V& v) {
-	auto mag = length(v);
-	if (mag == 0) [[unlikely]] {
-		return v;
+	if constexpr (requires { v.toSIMD(); }) {
+		return V::fromSIMD(SIMD::normalized(v.toSIMD()));
+	} else {
+		auto mag = length(v);
+		if (mag == 0) [[unlikely]] {
+			return v;
+		}
+		return v / mag;
 	}
-	return v / mag;
 }
 
 template <typename T = f32> struct Matrix3 {
@@ -177,7 +250,7 @@ template <typename T = f32> struct Matrix3 {
 	friend inline Vector operator*(const Matrix3& m, const Vector& v) { return m[0] * v.x + m[1] * v.y + m[2] * v.z; }
 
 	friend inline Matrix3 operator*(const Matrix3& a, const Matrix3& b) { return {a * b[0], a * b[1], a * b[2]}; }
-	friend inline Matrix3 operator*=(Matrix3& a, const Matrix3& b) { return {a *= b[0], a *= b[1], a *= b[2]}; }
+	friend inline Matrix3 operator*=(Matrix3& a, const Matrix3& b) { return a = a * b; }
 
 	template <typename R> friend R& operator>>(R& r, Matrix3& m) { return r >> m[0] >> m[1] >> m[2] >> m[3]; }
 
@@ -216,6 +289,7 @@ template <typename T = f32> struct Matrix4 {
 	static_assert(std::is_floating_point_v<T>);
 
 	using Vector = Vector4<T>;
+	static constexpr bool simd = Vector::simd;
 
 	Vector columns[4];
 
@@ -245,8 +319,157 @@ template <typename T = f32> struct Matrix4 {
 	friend inline Matrix4 operator*(const Matrix4& a, const Matrix4& b) {
 		return {a * b[0], a * b[1], a * b[2], a * b[3]};
 	}
-	friend inline Matrix4 operator*=(Matrix4& a, const Matrix4& b) {
-		return {a *= b[0], a *= b[1], a *= b[2], a *= b[3]};
+	friend inline Matrix4 operator*=(Matrix4& a, const Matrix4& b) { return a = a * b; }
+
+	// An affine transform split into translation, a rotation quaternion (x, y, z, w) and scale. Shear is lost
+	struct TRS {
+		Vector3<T> translation;
+		Vector rotation;
+		Vector3<T> scale;
+	};
+
+	friend inline TRS decompose(const Matrix4& m) {
+		Vector3<T> c[3] = {{m[0].x, m[0].y, m[0].z}, {m[1].x, m[1].y, m[1].z}, {m[2].x, m[2].y, m[2].z}};
+		Vector3<T> scale = {length(c[0]), length(c[1]), length(c[2])};
+		// A mirroring transform keeps a negative x scale, so what is left is a rotation
+		if (dot(c[0], cross(c[1], c[2])) < 0)
+			scale.x = -scale.x;
+		for (int i = 0; i < 3; i++) {
+			if (scale[i] != 0)
+				c[i] /= scale[i];
+		}
+
+		// Divides by the largest of the four components, for precision
+		Vector q;
+		T trace = c[0].x + c[1].y + c[2].z;
+		if (trace > 0) {
+			T s = std::sqrt(trace + 1) * 2;
+			q = {(c[1].z - c[2].y) / s, (c[2].x - c[0].z) / s, (c[0].y - c[1].x) / s, s / 4};
+		} else if (c[0].x > c[1].y && c[0].x > c[2].z) {
+			T s = std::sqrt(1 + c[0].x - c[1].y - c[2].z) * 2;
+			q = {s / 4, (c[1].x + c[0].y) / s, (c[2].x + c[0].z) / s, (c[1].z - c[2].y) / s};
+		} else if (c[1].y > c[2].z) {
+			T s = std::sqrt(1 + c[1].y - c[0].x - c[2].z) * 2;
+			q = {(c[1].x + c[0].y) / s, s / 4, (c[2].y + c[1].z) / s, (c[2].x - c[0].z) / s};
+		} else {
+			T s = std::sqrt(1 + c[2].z - c[0].x - c[1].y) * 2;
+			q = {(c[2].x + c[0].z) / s, (c[2].y + c[1].z) / s, s / 4, (c[0].y - c[1].x) / s};
+		}
+
+		return {{m[3].x, m[3].y, m[3].z}, normalized(q), scale};
+	}
+
+	static Matrix4 fromTRS(const TRS& trs) {
+		const Vector& q = trs.rotation;
+		const Vector3<T>& s = trs.scale;
+		return {
+			Vector{1 - 2 * (q.y * q.y + q.z * q.z), 2 * (q.x * q.y + q.w * q.z), 2 * (q.x * q.z - q.w * q.y), 0} * s.x,
+			Vector{2 * (q.x * q.y - q.w * q.z), 1 - 2 * (q.x * q.x + q.z * q.z), 2 * (q.y * q.z + q.w * q.x), 0} * s.y,
+			Vector{2 * (q.x * q.z + q.w * q.y), 2 * (q.y * q.z - q.w * q.x), 1 - 2 * (q.x * q.x + q.y * q.y), 0} * s.z,
+			{trs.translation.x, trs.translation.y, trs.translation.z, 1},
+		};
+	}
+
+	// Blends translation and scale linearly and the rotation along the shorter arc, so a rotating transform
+	// doesn't shrink halfway. Both must be affine
+	friend inline Matrix4 lerp(const Matrix4& a, const Matrix4& b, T t) {
+		if (a == b)
+			return a;
+
+		TRS from = decompose(a), to = decompose(b);
+		// q and -q are the same rotation
+		if (dot(from.rotation, to.rotation) < 0)
+			to.rotation = -to.rotation;
+		return fromTRS({
+			lerp(from.translation, to.translation, t),
+			normalized(lerp(from.rotation, to.rotation, t)),
+			lerp(from.scale, to.scale, t),
+		});
+	}
+
+	friend inline Matrix4 transpose(const Matrix4& m) {
+		if constexpr (simd) {
+			SIMD::f32x4 c0 = m[0].toSIMD(), c1 = m[1].toSIMD(), c2 = m[2].toSIMD(), c3 = m[3].toSIMD();
+			SIMD::transpose(c0, c1, c2, c3);
+			return {Vector::fromSIMD(c0), Vector::fromSIMD(c1), Vector::fromSIMD(c2), Vector::fromSIMD(c3)};
+		} else {
+			return {
+				{m[0].x, m[1].x, m[2].x, m[3].x},
+				{m[0].y, m[1].y, m[2].y, m[3].y},
+				{m[0].z, m[1].z, m[2].z, m[3].z},
+				{m[0].w, m[1].w, m[2].w, m[3].w},
+			};
+		}
+	}
+
+	// Only valid when the bottom row is 0, 0, 0, 1, which holds for all node and model transforms
+	friend inline Matrix4 affineInverse(const Matrix4& m) {
+		if constexpr (simd) {
+			// The rows of the inverse 3x3 are the cross products of its columns, over the determinant
+			SIMD::f32x4 c0 = m[0].toSIMD(), c1 = m[1].toSIMD(), c2 = m[2].toSIMD(), t = m[3].toSIMD();
+			SIMD::f32x4 r0 = SIMD::cross(c1, c2), r1 = SIMD::cross(c2, c0), r2 = SIMD::cross(c0, c1);
+			SIMD::f32x4 inv_det = SIMD::f32x4::splat(1 / SIMD::dot(c0, r0));
+			r0 = r0 * inv_det;
+			r1 = r1 * inv_det;
+			r2 = r2 * inv_det;
+			SIMD::f32x4 r3 = SIMD::f32x4::set(0, 0, 0, 1);
+			SIMD::transpose(r0, r1, r2, r3);
+			SIMD::f32x4 translation = r0 * t.template lane<0>() + r1 * t.template lane<1>() + r2 * t.template lane<2>();
+			return {
+				Vector::fromSIMD(r0),
+				Vector::fromSIMD(r1),
+				Vector::fromSIMD(r2),
+				Vector::fromSIMD(SIMD::f32x4::set(0, 0, 0, 1) - translation),
+			};
+		} else {
+			Vector3<T> c0 = {m[0].x, m[0].y, m[0].z}, c1 = {m[1].x, m[1].y, m[1].z}, c2 = {m[2].x, m[2].y, m[2].z};
+			Vector3<T> t = {m[3].x, m[3].y, m[3].z};
+			Vector3<T> r0 = cross(c1, c2), r1 = cross(c2, c0), r2 = cross(c0, c1);
+			T inv_det = 1 / dot(c0, r0);
+			r0 *= inv_det;
+			r1 *= inv_det;
+			r2 *= inv_det;
+			return {
+				{r0.x, r1.x, r2.x, 0},
+				{r0.y, r1.y, r2.y, 0},
+				{r0.z, r1.z, r2.z, 0},
+				{-dot(r0, t), -dot(r1, t), -dot(r2, t), 1},
+			};
+		}
+	}
+
+	// General inverse from the 2x2 minors of the top and bottom two rows
+	friend inline Matrix4 inverse(const Matrix4& m) {
+		const Vector &c0 = m[0], &c1 = m[1], &c2 = m[2], &c3 = m[3];
+		T s0 = c0.x * c1.y - c0.y * c1.x;
+		T s1 = c0.x * c2.y - c0.y * c2.x;
+		T s2 = c0.x * c3.y - c0.y * c3.x;
+		T s3 = c1.x * c2.y - c1.y * c2.x;
+		T s4 = c1.x * c3.y - c1.y * c3.x;
+		T s5 = c2.x * c3.y - c2.y * c3.x;
+		T k0 = c0.z * c1.w - c0.w * c1.z;
+		T k1 = c0.z * c2.w - c0.w * c2.z;
+		T k2 = c0.z * c3.w - c0.w * c3.z;
+		T k3 = c1.z * c2.w - c1.w * c2.z;
+		T k4 = c1.z * c3.w - c1.w * c3.z;
+		T k5 = c2.z * c3.w - c2.w * c3.z;
+		T inv_det = 1 / (s0 * k5 - s1 * k4 + s2 * k3 + s3 * k2 - s4 * k1 + s5 * k0);
+
+		// Built as rows, then transposed into columns
+		Matrix4 r = {
+			{c1.y * k5 - c2.y * k4 + c3.y * k3, -c1.x * k5 + c2.x * k4 - c3.x * k3,
+			 c1.w * s5 - c2.w * s4 + c3.w * s3, -c1.z * s5 + c2.z * s4 - c3.z * s3},
+			{-c0.y * k5 + c2.y * k2 - c3.y * k1, c0.x * k5 - c2.x * k2 + c3.x * k1,
+			 -c0.w * s5 + c2.w * s2 - c3.w * s1, c0.z * s5 - c2.z * s2 + c3.z * s1},
+			{c0.y * k4 - c1.y * k2 + c3.y * k0, -c0.x * k4 + c1.x * k2 - c3.x * k0,
+			 c0.w * s4 - c1.w * s2 + c3.w * s0, -c0.z * s4 + c1.z * s2 - c3.z * s0},
+			{-c0.y * k3 + c1.y * k1 - c2.y * k0, c0.x * k3 - c1.x * k1 + c2.x * k0,
+			 -c0.w * s3 + c1.w * s1 - c2.w * s0, c0.z * s3 - c1.z * s1 + c2.z * s0},
+		};
+		r = transpose(r);
+		for (Vector& c : r.columns)
+			c *= inv_det;
+		return r;
 	}
 
 	template <typename R> friend R& operator>>(R& r, Matrix4& m) { return r >> m[0] >> m[1] >> m[2] >> m[3]; }
@@ -260,16 +483,35 @@ template <typename T = f32> struct Matrix4 {
 	}
 
 	static Matrix4 lookAt(Vector3<T> eye, Vector3<T> center, Vector3<T> up) {
-		Vector3<T> backwards = normalized(eye - center);
-		Vector3<T> side = normalized(cross(up, backwards));
-		up = normalized(cross(backwards, side));
-
-		return {
-			{side.x, up.x, backwards.x, 0},
-			{side.y, up.y, backwards.y, 0},
-			{side.z, up.z, backwards.z, 0},
-			{dot(-eye, side), dot(-eye, up), dot(-eye, backwards), 1},
-		};
+		if constexpr (simd) {
+			SIMD::f32x4 e = eye.toSIMD();
+			SIMD::f32x4 backwards = SIMD::normalized(e - center.toSIMD());
+			SIMD::f32x4 side = SIMD::normalized(SIMD::cross(up.toSIMD(), backwards));
+			SIMD::f32x4 u = SIMD::normalized(SIMD::cross(backwards, side));
+
+			// The axes are the rows of the rotation
+			SIMD::f32x4 w = SIMD::f32x4::set(0, 0, 0, 1);
+			SIMD::transpose(side, u, backwards, w);
+			SIMD::f32x4 translation =
+				side * e.template lane<0>() + u * e.template lane<1>() + backwards * e.template lane<2>();
+			return {
+				Vector::fromSIMD(side),
+				Vector::fromSIMD(u),
+				Vector::fromSIMD(backwards),
+				Vector::fromSIMD(w - translation),
+			};
+		} else {
+			Vector3<T> backwards = normalized(eye - center);
+			Vector3<T> side = normalized(cross(up, backwards));
+			up = normalized(cross(backwards, side));
+
+			return {
+				{side.x, up.x, backwards.x, 0},
+				{side.y, up.y, backwards.y, 0},
+				{side.z, up.z, backwards.z, 0},
+				{dot(-eye, side), dot(-eye, up), dot(-eye, backwards), 1},
+			};
+		}
 	}
 
 	// This is a little special
@@ -278,13 +520,12 @@ template <typename T = f32> struct Matrix4 {
 		T halfFov = fovy / 2;
 		T cot = cos(halfFov) / sin(halfFov);
 
-		Matrix4 m;
-		m[0][0] = -cot / aspect;
-		m[1][1] = cot;
-		m[2][3] = -1.0f;
-		m[3][2] = zNear;
-
-		return m;
+		return {
+			{-cot / aspect, 0, 0, 0},
+			{0, cot, 0, 0},
+			{0, 0, 0, -1},
+			{0, 0, zNear, 0},
+		};
 	}
 };
 
@@ -28,6 +28,8 @@ class ModelCache {
 
 	struct Material {
 		index texture = index_null;
+		bool emissive = false;
+		bool double_sided = false;
 
 		bool operator==(const Material&) const = default;
 	};
@@ -45,6 +47,9 @@ class ModelCache {
 			index num_vertices;
 			index material;
 			index node;
+			// Bounding sphere of the vertices, in the space of the node
+			vec3 center = {0, 0, 0};
+			f32 radius = 0;
 		};
 		std::vector<Mesh> meshes;
 	};
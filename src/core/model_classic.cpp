@@ -384,6 +384,8 @@ u32 ModelCache::loadClassicModel(const FS::Path& path) {
 	}
 
 	std::vector<Surface> triangles;
+	// Parallel to triangles
+	std::vector<vec3> face_normals;
 
 	for (auto& po : polygon_objects) {
 		model.nodes.push_back({.transform = po.localMatrix});
@@ -425,11 +427,23 @@ u32 ModelCache::loadClassicModel(const FS::Path& path) {
 				}
 				triangles.back().vertices.push_back({.pos = v.pos, .normal = n.pos, .uv = uv});
 			}
+
+			geo.cursor = po.pNormalList + pe.iFaceNormal * sizeof(Classic::Geo::VertexEntry);
+			face_normals.push_back(geo.get<Classic::Geo::VertexEntry>().pos);
 		}
 	}
 
 	patch(path, triangles);
 
+	// Wind every triangle counter-clockwise around its face normal, so back faces can be culled
+	// This comes after patching, which picks out corners by index
+	for (size_t t = 0; t < triangles.size(); t++) {
+		auto& corners = triangles[t].vertices;
+		if (dot(cross(corners[1].pos - corners[0].pos, corners[2].pos - corners[0].pos), face_normals[t]) < 0) {
+			std::swap(corners[1], corners[2]);
+		}
+	}
+
 	std::vector<Texture> local_textures;
 
 	for (auto& t : texture_names) {
@@ -480,7 +494,10 @@ u32 ModelCache::loadClassicModel(const FS::Path& path) {
 	}
 
 	for (auto& s : surfaces) {
-		Material mat{.texture = s.texture + textures.size()};
+		if (s.vertices.empty())
+			continue;
+
+		Material mat{.texture = s.texture + textures.size(), .emissive = s.emissive, .double_sided = s.double_sided};
 		index mat_index = materials.size();
 		for (index i = 0; i < materials.size(); i++) {
 			auto& mat_ = materials[i];
@@ -492,7 +509,19 @@ u32 ModelCache::loadClassicModel(const FS::Path& path) {
 			materials.push_back(mat);
 		}
 
-		model.meshes.push_back(Model::Mesh{vertices.size(), s.vertices.size(), mat_index, s.node});
+		Model::Mesh mesh{vertices.size(), s.vertices.size(), mat_index, s.node};
+		{
+			vec3 min = s.vertices.front().pos, max = min;
+			for (auto& v : s.vertices) {
+				min = {std::min(min.x, v.pos.x), std::min(min.y, v.pos.y), std::min(min.z, v.pos.z)};
+				max = {std::max(max.x, v.pos.x), std::max(max.y, v.pos.y), std::max(max.z, v.pos.z)};
+			}
+			mesh.center = (min + max) / 2;
+			for (auto& v : s.vertices) {
+				mesh.radius = std::max<f32>(mesh.radius, length(v.pos - mesh.center));
+			}
+		}
+		model.meshes.push_back(mesh);
 		vertices.insert(vertices.end(), s.vertices.begin(), s.vertices.end());
 	}
 
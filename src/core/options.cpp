@@ -0,0 +1,19 @@
+#include "options.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace Options {
+
+std::optional<std::string> get(const std::string& name) {
+	std::string env_name = "GUIDESTONE_" + name;
+	std::ranges::transform(env_name, env_name.begin(), [](unsigned char c) { return std::toupper(c); });
+
+	const char* value = getenv(env_name.c_str());
+	if (value == nullptr)
+		return {};
+	return value;
+}
+
+} // namespace Options
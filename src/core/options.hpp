@@ -0,0 +1,36 @@
+#pragma once
+
+#include "log.hpp"
+#include <charconv>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+// Engine tunables
+// TODO: Load these from a config file, for now they come from GUIDESTONE_<NAME> environment variables
+namespace Options {
+
+std::optional<std::string> get(const std::string& name);
+
+template <typename T> T get(const std::string& name, T fallback) {
+	auto value = get(name);
+	if (!value.has_value())
+		return fallback;
+
+	if constexpr (std::is_same_v<T, std::string>) {
+		return value.value();
+	} else if constexpr (std::is_same_v<T, bool>) {
+		return !(value == "0" || value == "false" || value == "off" || value == "no");
+	} else {
+		static_assert(std::is_arithmetic_v<T>);
+		T result;
+		auto [end, error] = std::from_chars(value->data(), value->data() + value->size(), result);
+		if (error != std::errc() || end != value->data() + value->size()) {
+			Log::warn("Invalid value for option " + name, value.value());
+			return fallback;
+		}
+		return result;
+	}
+}
+
+} // namespace Options
@@ -3,17 +3,70 @@
 #include "active/camera.hpp"
 #include "model.hpp"
 #include "types.hpp"
+#include <array>
+#include <chrono>
+#include <optional>
+#include <span>
 
 class Render {
   public:
 	virtual void resize(uvec2) = 0;
 
+	struct Instance {
+		ModelCache::index model;
+		mat4 transform = mat4::identity();
+		u32 team = 0;
+	};
+
 	// This is stuff that could change every render frame
 	struct FrameInfo {
 		const Camera& camera;
+		std::span<const Instance> instances;
+		// When the oldest input event the frame is the first to reflect arrived, if there were any
+		std::optional<std::chrono::steady_clock::time_point> input_time;
 	};
 	virtual void renderFrame(FrameInfo) = 0;
 	virtual void setModelCache(const ModelCache&) = 0;
 
+	// Measurements of the last rendered frame
+	struct Stats {
+		u32 instances = 0;
+		u32 draws = 0;
+		// Binds recorded into the frame's command buffers, after redundant ones are skipped
+		u32 pipeline_binds = 0;
+		u32 descriptor_binds = 0;
+		// Meshes drawn and left out by culling, counted per instance
+		// When culling on the GPU these and draws are read back, and lag like gpu_time
+		u32 visible = 0;
+		u32 culled = 0;
+		// Meshes in the frustum but hidden behind what was drawn, only with occlusion culling
+		u32 occluded = 0;
+		// Milliseconds spent recording and submitting
+		f32 cpu_time = 0;
+		// Milliseconds between the first and last command on the GPU
+		// This lags a few frames behind
+		f32 gpu_time = 0;
+		// Milliseconds from an input event to the first frame reflecting it being shown, or queued for presenting
+		// when the device can't wait on presents. Only frames with input have one, and they lag behind too,
+		// so a frame may report none or several
+		static constexpr u32 max_latencies = 4;
+		std::array<f32, max_latencies> latencies = {};
+		u32 latency_count = 0;
+		// Whether they run until the present was shown, otherwise only until it was queued
+		bool latency_shown = false;
+		// Filled in by the render thread: frames it waited for the simulation to publish,
+		// and times the simulation waited for it to pick up the previous frame
+		u32 render_waits = 0;
+		u32 simulation_waits = 0;
+		// Filled in from the simulation: frames it didn't publish while the window was hidden,
+		// and milliseconds it slept to hold the frame rate cap
+		u32 frames_skipped = 0;
+		f32 sleep_time = 0;
+		// Heap allocations on the render thread during the frame, only counted in debug builds
+		// Once the frames are the same size from one to the next this should stay at zero
+		u32 allocations = 0;
+	};
+	virtual const Stats& stats() const = 0;
+
 	virtual ~Render() = default;
 };
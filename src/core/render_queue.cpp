@@ -0,0 +1,39 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+u64 RenderQueue::key(Pass pass, u32 variant, u32 material, f32 depth) {
+	// Logarithmic, so there is more precision close to the camera
+	u64 bucket = static_cast<u64>(std::clamp(std::log2(std::max(depth, 1.0f)) * 4096.0f, 0.0f, 65535.0f));
+	if (pass == Pass::Blended)
+		bucket = depth_mask - bucket;
+
+	return static_cast<u64>(pass) << pass_shift | (variant & variant_mask) << variant_shift |
+		(material & material_mask) << material_shift | bucket << depth_shift;
+}
+
+void RenderQueue::sort() {
+	if (entries.empty())
+		return;
+
+	scratch.resize(entries.size());
+	for (u32 shift = 0; shift < 64; shift += 8) {
+		std::array<u32, 256> offsets = {};
+		for (auto& e : entries)
+			offsets[(e.key >> shift) & 0xFF]++;
+		if (offsets[(entries.front().key >> shift) & 0xFF] == entries.size())
+			continue;
+
+		u32 sum = 0;
+		for (auto& o : offsets) {
+			u32 count = o;
+			o = sum;
+			sum += count;
+		}
+		for (auto& e : entries)
+			scratch[offsets[(e.key >> shift) & 0xFF]++] = e;
+		entries.swap(scratch);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "types.hpp"
+#include <span>
+#include <vector>
+
+// Draws ordered by a 64 bit key, so that draws sharing state end up next to each other.
+// From the top bit down the key holds the pass, the pipeline variant, the material and a depth bucket.
+// Opaque draws go front to back to make the most of early depth testing, blended ones back to front.
+class RenderQueue {
+  public:
+	enum class Pass : u64 { Opaque = 0, Blended = 1 };
+
+	struct Entry {
+		u64 key;
+		// Whatever the renderer uses to find the draw again
+		u32 payload;
+	};
+
+	static constexpr u32 pass_shift = 62;
+	static constexpr u32 variant_shift = 58;
+	static constexpr u32 material_shift = 34;
+	static constexpr u32 depth_shift = 18;
+	static constexpr u64 variant_mask = 0xF;
+	static constexpr u64 material_mask = 0xFFFFFF;
+	static constexpr u64 depth_mask = 0xFFFF;
+
+	// Depth is the distance along the view direction
+	static u64 key(Pass, u32 variant, u32 material, f32 depth);
+	static u32 variant(u64 key) { return (key >> variant_shift) & variant_mask; }
+	// Draws with the same state prefix can share a pipeline
+	static u64 pipeline_state(u64 key) { return key >> variant_shift; }
+
+  private:
+	std::vector<Entry> entries;
+	std::vector<Entry> scratch;
+
+  public:
+	void clear() { entries.clear(); }
+	void push(u64 key, u32 payload) { entries.push_back({key, payload}); }
+	// Radix sort, stable, skipping the bytes every key has in common
+	void sort();
+
+	std::span<const Entry> sorted() const { return entries; }
+	size_t size() const { return entries.size(); }
+};
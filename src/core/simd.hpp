@@ -0,0 +1,151 @@
+#pragma once
+
+#include "types.hpp"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define GUIDESTONE_SSE
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define GUIDESTONE_NEON
+#include <arm_neon.h>
+#endif
+
+// Four floats in a register, with a scalar fallback when there is no vector unit
+namespace SIMD {
+
+#if defined(GUIDESTONE_SSE)
+
+struct f32x4 {
+	__m128 v;
+
+	static f32x4 load(const f32* p) { return {_mm_loadu_ps(p)}; }
+	static f32x4 set(f32 x, f32 y, f32 z, f32 w) { return {_mm_setr_ps(x, y, z, w)}; }
+	static f32x4 splat(f32 s) { return {_mm_set1_ps(s)}; }
+	void store(f32* p) const { _mm_storeu_ps(p, v); }
+
+	template <int i> f32x4 lane() const { return {_mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i))}; }
+	// For cross products
+	f32x4 yzx() const { return {_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1))}; }
+
+	friend f32x4 operator+(f32x4 a, f32x4 b) { return {_mm_add_ps(a.v, b.v)}; }
+	friend f32x4 operator-(f32x4 a, f32x4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+	friend f32x4 operator*(f32x4 a, f32x4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+	friend f32x4 operator/(f32x4 a, f32x4 b) { return {_mm_div_ps(a.v, b.v)}; }
+};
+
+inline void transpose(f32x4& a, f32x4& b, f32x4& c, f32x4& d) { _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v); }
+
+// Bit i is set when lane i of a is less than lane i of b
+inline u32 less_mask(f32x4 a, f32x4 b) { return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)); }
+
+// Sums the lanes in order, like the scalar code, so results don't depend on the vector unit
+inline f32 dot(f32x4 a, f32x4 b) {
+	__m128 m = _mm_mul_ps(a.v, b.v);
+	__m128 sum = _mm_add_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+	sum = _mm_add_ss(sum, _mm_movehl_ps(m, m));
+	return _mm_cvtss_f32(_mm_add_ss(sum, _mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 3, 3, 3))));
+}
+
+#elif defined(GUIDESTONE_NEON)
+
+struct f32x4 {
+	float32x4_t v;
+
+	static f32x4 load(const f32* p) { return {vld1q_f32(p)}; }
+	static f32x4 set(f32 x, f32 y, f32 z, f32 w) {
+		f32 p[4] = {x, y, z, w};
+		return load(p);
+	}
+	static f32x4 splat(f32 s) { return {vdupq_n_f32(s)}; }
+	void store(f32* p) const { vst1q_f32(p, v); }
+
+	template <int i> f32x4 lane() const { return {vdupq_n_f32(vgetq_lane_f32(v, i))}; }
+	f32x4 yzx() const {
+		float32x4_t yzwx = vextq_f32(v, v, 1);
+		return {vsetq_lane_f32(vgetq_lane_f32(v, 0), vsetq_lane_f32(vgetq_lane_f32(v, 3), yzwx, 3), 2)};
+	}
+
+	friend f32x4 operator+(f32x4 a, f32x4 b) { return {vaddq_f32(a.v, b.v)}; }
+	friend f32x4 operator-(f32x4 a, f32x4 b) { return {vsubq_f32(a.v, b.v)}; }
+	friend f32x4 operator*(f32x4 a, f32x4 b) { return {vmulq_f32(a.v, b.v)}; }
+	friend f32x4 operator/(f32x4 a, f32x4 b) { return {vdivq_f32(a.v, b.v)}; }
+};
+
+inline void transpose(f32x4& a, f32x4& b, f32x4& c, f32x4& d) {
+	float32x4x2_t ab = vtrnq_f32(a.v, b.v);
+	float32x4x2_t cd = vtrnq_f32(c.v, d.v);
+	a.v = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+	b.v = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+	c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+inline f32 dot(f32x4 a, f32x4 b) {
+	float32x4_t m = vmulq_f32(a.v, b.v);
+	return ((vgetq_lane_f32(m, 0) + vgetq_lane_f32(m, 1)) + vgetq_lane_f32(m, 2)) + vgetq_lane_f32(m, 3);
+}
+
+inline u32 less_mask(f32x4 a, f32x4 b) {
+	const uint32x4_t bits = {1, 2, 4, 8};
+	return vaddvq_u32(vandq_u32(vcltq_f32(a.v, b.v), bits));
+}
+
+#else
+
+struct f32x4 {
+	f32 v[4];
+
+	static f32x4 load(const f32* p) { return {{p[0], p[1], p[2], p[3]}}; }
+	static f32x4 set(f32 x, f32 y, f32 z, f32 w) { return {{x, y, z, w}}; }
+	static f32x4 splat(f32 s) { return {{s, s, s, s}}; }
+	void store(f32* p) const {
+		for (int i = 0; i < 4; i++)
+			p[i] = v[i];
+	}
+
+	template <int i> f32x4 lane() const { return splat(v[i]); }
+	f32x4 yzx() const { return {{v[1], v[2], v[0], v[3]}}; }
+
+	template <typename F> static f32x4 apply(f32x4 a, f32x4 b, F f) {
+		return {{f(a.v[0], b.v[0]), f(a.v[1], b.v[1]), f(a.v[2], b.v[2]), f(a.v[3], b.v[3])}};
+	}
+	friend f32x4 operator+(f32x4 a, f32x4 b) { return apply(a, b, [](f32 x, f32 y) { return x + y; }); }
+	friend f32x4 operator-(f32x4 a, f32x4 b) { return apply(a, b, [](f32 x, f32 y) { return x - y; }); }
+	friend f32x4 operator*(f32x4 a, f32x4 b) { return apply(a, b, [](f32 x, f32 y) { return x * y; }); }
+	friend f32x4 operator/(f32x4 a, f32x4 b) { return apply(a, b, [](f32 x, f32 y) { return x / y; }); }
+};
+
+inline void transpose(f32x4& a, f32x4& b, f32x4& c, f32x4& d) {
+	f32x4 r[4] = {a, b, c, d};
+	for (int i = 0; i < 4; i++) {
+		a.v[i] = r[i].v[0];
+		b.v[i] = r[i].v[1];
+		c.v[i] = r[i].v[2];
+		d.v[i] = r[i].v[3];
+	}
+}
+
+inline f32 dot(f32x4 a, f32x4 b) { return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2] + a.v[3] * b.v[3]; }
+
+inline u32 less_mask(f32x4 a, f32x4 b) {
+	u32 mask = 0;
+	for (int i = 0; i < 4; i++)
+		mask |= (a.v[i] < b.v[i] ? 1u : 0u) << i;
+	return mask;
+}
+
+#endif
+
+inline f32x4 cross(f32x4 a, f32x4 b) { return (a * b.yzx() - a.yzx() * b).yzx(); }
+
+// Zero length vectors are returned unchanged
+inline f32x4 normalized(f32x4 v) {
+	f32 mag = std::sqrt(dot(v, v));
+	if (mag == 0) [[unlikely]] {
+		return v;
+	}
+	return v / f32x4::splat(mag);
+}
+
+} // namespace SIMD
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "types.hpp"
+#include <array>
+#include <atomic>
+#include <bit>
+
+// Fixed size queue from one producer thread to one consumer thread, neither side ever locks or waits.
+//
+// Each side only writes its own index and reads the other's to see how far it can go. Both keep a copy of the
+// other's index and only reload it when the copy says the queue is full or empty, so while there is room the
+// sides don't touch each other's cache lines at all.
+template <typename T, size_t capacity> class SPSCQueue {
+	static_assert(std::has_single_bit(capacity));
+	static constexpr size_t line = 64;
+
+	std::array<T, capacity> items;
+
+	// Next to read, written by the consumer
+	alignas(line) std::atomic<size_t> head = 0;
+	size_t cached_tail = 0;
+	// Next to write, written by the producer
+	alignas(line) std::atomic<size_t> tail = 0;
+	size_t cached_head = 0;
+
+  public:
+	// Producer only, returns false and drops the item when full
+	bool push(const T& item) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - cached_head == capacity) {
+			cached_head = head.load(std::memory_order_acquire);
+			if (t - cached_head == capacity)
+				return false;
+		}
+		items[t % capacity] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only, calls f on everything pushed so far in order and returns how many there were
+	template <typename F> size_t drain(F&& f) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == cached_tail) {
+			cached_tail = tail.load(std::memory_order_acquire);
+		}
+		size_t count = cached_tail - h;
+		for (; h != cached_tail; h++) {
+			f(items[h % capacity]);
+		}
+		head.store(h, std::memory_order_release);
+		return count;
+	}
+};
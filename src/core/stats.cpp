@@ -0,0 +1,78 @@
+#include "stats.hpp"
+
+#include "allocations.hpp"
+#include "log.hpp"
+#include "options.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+StatsLog::StatsLog()
+	: interval(std::chrono::duration_cast<clock::duration>(
+		  std::chrono::duration<f32>(Options::get("stats_interval", 0.0f)))),
+	  interval_start(clock::now()) {}
+
+f32 StatsLog::percentile(f32 p) {
+	if (latencies.empty())
+		return 0;
+	auto nth = latencies.begin() + std::min<size_t>(p * latencies.size(), latencies.size() - 1);
+	std::nth_element(latencies.begin(), nth, latencies.end());
+	return *nth;
+}
+
+void StatsLog::frame(const Render::Stats& stats) {
+	if (interval == clock::duration::zero())
+		return;
+
+	frames++;
+	total.instances += stats.instances;
+	total.draws += stats.draws;
+	total.pipeline_binds += stats.pipeline_binds;
+	total.descriptor_binds += stats.descriptor_binds;
+	total.visible += stats.visible;
+	total.culled += stats.culled;
+	total.occluded += stats.occluded;
+	total.cpu_time += stats.cpu_time;
+	total.gpu_time += stats.gpu_time;
+	total.render_waits += stats.render_waits;
+	total.simulation_waits += stats.simulation_waits;
+	total.frames_skipped += stats.frames_skipped;
+	total.sleep_time += stats.sleep_time;
+	total.allocations += stats.allocations;
+	peak.cpu_time = std::max(peak.cpu_time, stats.cpu_time);
+	peak.gpu_time = std::max(peak.gpu_time, stats.gpu_time);
+	latencies.insert(latencies.end(), stats.latencies.begin(), stats.latencies.begin() + stats.latency_count);
+	latency_shown = stats.latency_shown;
+
+	clock::time_point now = clock::now();
+	if (now - interval_start < interval)
+		return;
+
+	f32 seconds = std::chrono::duration<f32>(now - interval_start).count();
+	std::ostringstream msg;
+	msg << std::fixed << std::setprecision(2);
+	msg << frames / seconds << " fps, " << total.instances / frames << " instances, " << total.draws / frames
+		<< " draws, " << total.visible / frames << " visible, " << total.culled / frames << " culled, "
+		<< total.occluded / frames << " occluded\n";
+	msg << total.pipeline_binds / frames << " pipeline binds, " << total.descriptor_binds / frames
+		<< " descriptor binds\n";
+	msg << "cpu " << total.cpu_time / frames << "ms (max " << peak.cpu_time << "ms), ";
+	msg << "gpu " << total.gpu_time / frames << "ms (max " << peak.gpu_time << "ms), ";
+	msg << (latency_shown ? "present latency " : "submit latency ") << percentile(0.5f) << "ms median, "
+		<< percentile(0.99f) << "ms 99th percentile, " << percentile(1) << "ms max over " << latencies.size()
+		<< " frames with input\n";
+	msg << "waited " << total.render_waits << " frames for the simulation, simulation waited "
+		<< total.simulation_waits << " times\n";
+	msg << "skipped " << total.frames_skipped << " frames while hidden, slept " << total.sleep_time / frames
+		<< "ms per frame for the frame rate cap";
+	if (Allocations::counted()) {
+		msg << "\n" << total.allocations << " heap allocations on the render thread";
+	}
+	Log::info("Render stats", msg.str());
+
+	interval_start = now;
+	frames = 0;
+	total = {};
+	peak = {};
+	latencies.clear();
+}
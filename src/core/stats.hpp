@@ -0,0 +1,27 @@
+#pragma once
+
+#include "render.hpp"
+#include <chrono>
+#include <vector>
+
+// Periodically logs the renderer stats averaged over the interval
+class StatsLog {
+	using clock = std::chrono::steady_clock;
+
+	clock::duration interval;
+	clock::time_point interval_start;
+
+	u64 frames = 0;
+	Render::Stats total;
+	Render::Stats peak;
+	// Every sample in the interval, for percentiles
+	std::vector<f32> latencies;
+	// Labels them as present or submit latency
+	bool latency_shown = false;
+	// Reorders the samples, 1 is the largest
+	f32 percentile(f32 p);
+
+  public:
+	StatsLog();
+	void frame(const Render::Stats&);
+};
@@ -0,0 +1,56 @@
+#include "transforms.hpp"
+
+#include "jobs.hpp"
+#include <algorithm>
+
+void TransformStage::setModelCache(const ModelCache& cache) {
+	nodes.clear();
+	locals.clear();
+	models.clear();
+
+	for (auto& model : cache.models) {
+		models.push_back({static_cast<u32>(nodes.size()), static_cast<u32>(model.nodes.size())});
+
+		std::vector<bool> placed(model.nodes.size());
+		auto place = [&](auto& place, u32 n) -> void {
+			if (placed[n])
+				return;
+			placed[n] = true;
+			ModelCache::index parent = model.nodes[n].parent_node;
+			if (parent != ModelCache::index_null)
+				place(place, parent);
+			nodes.push_back({n, parent == ModelCache::index_null ? no_parent : static_cast<u32>(parent)});
+			locals.push_back(model.nodes[n].transform);
+		};
+		for (u32 n = 0; n < model.nodes.size(); n++) {
+			place(place, n);
+		}
+	}
+}
+
+void TransformStage::evaluate(const Render::Instance& instance, mat4* out) const {
+	if (instance.model >= models.size())
+		return;
+
+	// The output is often write combined memory, which is slow to read parents back from
+	thread_local std::vector<mat4> world;
+	Model model = models[instance.model];
+	world.resize(model.count);
+	for (u32 i = model.first; i < model.first + model.count; i++) {
+		const mat4& parent = nodes[i].parent == no_parent ? instance.transform : world[nodes[i].parent];
+		world[nodes[i].index] = parent * locals[i];
+	}
+	std::copy(world.begin(), world.end(), out);
+}
+
+// Enough work per job to outweigh queueing it
+constexpr u32 instances_per_job = 1024;
+
+void TransformStage::evaluate(
+	std::span<const Render::Instance> instances, std::span<const u32> bases, mat4* out) const {
+	Jobs::parallel_for(instances.size(), instances_per_job, [&](u32 begin, u32 end) {
+		for (u32 i = begin; i < end; i++) {
+			evaluate(instances[i], out + bases[i]);
+		}
+	});
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "math.hpp"
+#include "model.hpp"
+#include "render.hpp"
+#include "types.hpp"
+#include <span>
+#include <vector>
+
+// Works out the world matrix of every node of every instance.
+// The node hierarchies are flattened into one array, each model's nodes ordered parents first,
+// so an instance is a single linear pass with every parent already evaluated.
+class TransformStage {
+	struct Node {
+		// Where the world matrix goes, relative to the instance's first
+		u32 index;
+		u32 parent;
+	};
+	std::vector<Node> nodes;
+	std::vector<mat4> locals;
+
+	struct Model {
+		u32 first;
+		u32 count;
+	};
+	std::vector<Model> models;
+
+	void evaluate(const Render::Instance&, mat4* out) const;
+
+  public:
+	static constexpr u32 no_parent = ~u32(0);
+
+	void setModelCache(const ModelCache&);
+
+	// World matrices written for each instance, zero for instances without a valid model
+	u32 nodeCount(ModelCache::index model) const { return model < models.size() ? models[model].count : 0; }
+
+	// Writes the world matrices of instance i starting at out + bases[i]
+	// Large batches are split into jobs
+	void evaluate(std::span<const Render::Instance>, std::span<const u32> bases, mat4* out) const;
+};
@@ -0,0 +1,120 @@
+#include "visibility.hpp"
+
+#include "jobs.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Largest scale along any axis, for growing a radius
+f32 max_scale(const mat4& m) {
+	auto axis = [&m](int c) { return lengthSquared(vec3{m[c].x, m[c].y, m[c].z}); };
+	return std::sqrt(std::max({axis(0), axis(1), axis(2)}));
+}
+
+constexpr f32 never_visible = -std::numeric_limits<f32>::infinity();
+
+} // namespace
+
+void VisibilityStage::setModelCache(const ModelCache& cache) {
+	model_spheres.clear();
+
+	for (auto& model : cache.models) {
+		// Nodes don't move relative to their model, so the spheres only need working out once
+		std::vector<mat4> world(model.nodes.size());
+		std::vector<bool> evaluated(model.nodes.size());
+		auto evaluate = [&](auto& evaluate, ModelCache::index n) -> mat4 {
+			if (n >= model.nodes.size())
+				return mat4::identity();
+			if (!evaluated[n]) {
+				world[n] = evaluate(evaluate, model.nodes[n].parent_node) * model.nodes[n].transform;
+				evaluated[n] = true;
+			}
+			return world[n];
+		};
+
+		std::vector<vec4> spheres;
+		constexpr f32 far = std::numeric_limits<f32>::max();
+		vec3 low = {far, far, far};
+		vec3 high = {-far, -far, -far};
+		for (auto& mesh : model.meshes) {
+			mat4 node = evaluate(evaluate, mesh.node);
+			vec4 center = node * vec4{mesh.center.x, mesh.center.y, mesh.center.z, 1};
+			f32 radius = mesh.radius * max_scale(node);
+			spheres.push_back({center.x, center.y, center.z, radius});
+			for (int a = 0; a < 3; a++) {
+				low[a] = std::min(low[a], center[a] - radius);
+				high[a] = std::max(high[a], center[a] + radius);
+			}
+		}
+		if (spheres.empty()) {
+			model_spheres.push_back({0, 0, 0, never_visible});
+			continue;
+		}
+
+		// Not the smallest sphere, but close enough for the few meshes a model has
+		vec3 center = (low + high) * 0.5f;
+		f32 radius = 0;
+		for (auto& s : spheres) {
+			radius = std::max(radius, length(vec3{s.x, s.y, s.z} - center) + s.w);
+		}
+		model_spheres.push_back({center.x, center.y, center.z, radius});
+	}
+}
+
+// Enough work per job to outweigh queueing it
+constexpr u32 instances_per_job = 4096;
+
+u32 VisibilityStage::cull(std::span<const Render::Instance> instances, const Frustum& frustum) {
+	size_t padded = (instances.size() + 3) & ~size_t(3);
+	xs.resize(padded);
+	ys.resize(padded);
+	zs.resize(padded);
+	radii.resize(padded);
+	visible.resize(padded);
+
+	using SIMD::f32x4;
+	f32x4 planes[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = f32x4::splat(frustum.planes[p][c]);
+	}
+
+	std::atomic<u32> total = 0;
+	Jobs::parallel_for(padded / 4, instances_per_job / 4, [&](u32 begin, u32 end) {
+		for (u32 i = begin * 4; i < end * 4; i++) {
+			if (i >= instances.size() || instances[i].model >= model_spheres.size()) {
+				xs[i] = ys[i] = zs[i] = 0;
+				radii[i] = never_visible;
+				continue;
+			}
+			const mat4& transform = instances[i].transform;
+			vec4 sphere = model_spheres[instances[i].model];
+			vec4 center = transform * vec4{sphere.x, sphere.y, sphere.z, 1};
+			xs[i] = center.x;
+			ys[i] = center.y;
+			zs[i] = center.z;
+			radii[i] = sphere.w * max_scale(transform);
+		}
+
+		u32 count = 0;
+		for (u32 i = begin * 4; i < end * 4; i += 4) {
+			f32x4 x = f32x4::load(&xs[i]), y = f32x4::load(&ys[i]), z = f32x4::load(&zs[i]);
+			f32x4 below = f32x4::splat(0) - f32x4::load(&radii[i]);
+			// A sphere is outside when its center is further than the radius behind any plane
+			u32 outside = 0;
+			for (auto& p : planes) {
+				outside |= SIMD::less_mask(p[0] * x + p[1] * y + p[2] * z + p[3], below);
+			}
+			for (u32 k = 0; k < 4; k++) {
+				visible[i + k] = !(outside >> k & 1);
+				count += visible[i + k];
+			}
+		}
+		total += count;
+	});
+	return total;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "frustum.hpp"
+#include "math.hpp"
+#include "model.hpp"
+#include "render.hpp"
+#include "types.hpp"
+#include <span>
+#include <vector>
+
+// Frustum culls whole instances, each against one sphere around all of its model's meshes.
+// The spheres are moved to world space into separate x, y, z and radius arrays,
+// so every plane is tested against four instances at once.
+class VisibilityStage {
+	// In model space, xyz is the center and w the radius
+	std::vector<vec4> model_spheres;
+
+	// Padded to a multiple of four, reused every frame
+	std::vector<f32> xs, ys, zs, radii;
+	std::vector<u8> visible;
+
+  public:
+	void setModelCache(const ModelCache&);
+
+	// Returns how many instances are visible, instances without a valid model never are
+	// Large batches are split into jobs
+	u32 cull(std::span<const Render::Instance>, const Frustum&);
+	bool isVisible(size_t instance) const { return visible[instance]; }
+};
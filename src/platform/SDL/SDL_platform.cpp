@@ -4,8 +4,14 @@
 #include "vulkan_render.hpp"
 #include <SDL_vulkan.h>
 
+// The wait returns as window system events arrive, this only bounds how long a missed wake up could stall it
+constexpr Sint32 max_event_wait_ms = 100;
+
 SDLPlatform::SDLPlatform(int argc, char* argv[]) : args(argv, argv + argc) {
 	SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO);
+	wake_event = SDL_RegisterEvents(1);
+	if (wake_event == static_cast<Uint32>(-1))
+		wake_event = SDL_USEREVENT;
 }
 
 void SDLPlatform::run() {
@@ -15,8 +21,9 @@ void SDLPlatform::run() {
 
 	engine->init();
 
+	SDL_Event wake;
 	while (!shutdown_semaphore.try_acquire()) {
-		SDL_PumpEvents();
+		SDL_WaitEventTimeout(&wake, max_event_wait_ms);
 	}
 
 	SDL_SetEventFilter(nullptr, nullptr);
@@ -31,7 +38,11 @@ void SDLPlatform::run() {
 SDLPlatform::~SDLPlatform() { SDL_Quit(); }
 
 int SDLPlatform::event_proc(void* userdata, SDL_Event* event) {
-	static_cast<SDLPlatform*>(userdata)->event_proc(*event);
+	auto& platform = *static_cast<SDLPlatform*>(userdata);
+	// Queued so the wait in run returns, it is pushed from whichever thread called shutdown
+	if (event->type == platform.wake_event)
+		return 1;
+	platform.event_proc(*event);
 	return 0;
 }
 void SDLPlatform::event_proc(const SDL_Event& ev) {
@@ -49,6 +60,21 @@ void SDLPlatform::event_proc(const SDL_Event& ev) {
 		case SDL_WINDOWEVENT_LEAVE: {
 			engine->active.input.mouse_position({});
 		} break;
+		case SDL_WINDOWEVENT_MINIMIZED:
+		case SDL_WINDOWEVENT_HIDDEN: {
+			engine->active.input.window_visible(false);
+		} break;
+		case SDL_WINDOWEVENT_RESTORED:
+		case SDL_WINDOWEVENT_MAXIMIZED:
+		case SDL_WINDOWEVENT_SHOWN: {
+			engine->active.input.window_visible(true);
+		} break;
+		case SDL_WINDOWEVENT_FOCUS_GAINED: {
+			engine->active.input.window_focus(true);
+		} break;
+		case SDL_WINDOWEVENT_FOCUS_LOST: {
+			engine->active.input.window_focus(false);
+		} break;
 		}
 	} break;
 	case SDL_MOUSEMOTION: {
@@ -107,7 +133,13 @@ std::unique_ptr<Render> SDLPlatform::init_video() {
 
 void SDLPlatform::set_relative_mouse(bool enable) { SDL_SetRelativeMouseMode(enable ? SDL_TRUE : SDL_FALSE); }
 
-void SDLPlatform::shutdown() { shutdown_semaphore.release(); }
+void SDLPlatform::shutdown() {
+	shutdown_semaphore.release();
+
+	SDL_Event wake{};
+	wake.type = wake_event;
+	SDL_PushEvent(&wake);
+}
 
 int main(int argc, char* argv[]) {
 #ifdef __LINUX__
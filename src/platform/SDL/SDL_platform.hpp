@@ -12,6 +12,8 @@ class SDLPlatform final : public Platform {
 	SDL_Window* window;
 
 	std::binary_semaphore shutdown_semaphore{0};
+	// Pushed by shutdown to wake the main thread, every other event is handled by the filter instead of queued
+	Uint32 wake_event;
 
   public:
 	SDLPlatform(SDLPlatform&) = delete;
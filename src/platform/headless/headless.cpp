@@ -0,0 +1,116 @@
+#include "headless.hpp"
+
+#include "log.hpp"
+#include "vulkan_render.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace Headless {
+
+// The loader is never closed, the dispatcher keeps pointers into it for the rest of the process
+static PFN_vkGetInstanceProcAddr load_vulkan() {
+#if defined(_WIN32)
+	HMODULE library = LoadLibraryA("vulkan-1.dll");
+	if (!library)
+		return nullptr;
+	return reinterpret_cast<PFN_vkGetInstanceProcAddr>(GetProcAddress(library, "vkGetInstanceProcAddr"));
+#else
+#if defined(__APPLE__)
+	void* library = dlopen("libvulkan.1.dylib", RTLD_NOW | RTLD_LOCAL);
+#else
+	void* library = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+#endif
+	if (!library)
+		return nullptr;
+	return reinterpret_cast<PFN_vkGetInstanceProcAddr>(dlsym(library, "vkGetInstanceProcAddr"));
+#endif
+}
+
+static bool has_headless_surface(PFN_vkGetInstanceProcAddr get_proc) {
+	auto enumerate = reinterpret_cast<PFN_vkEnumerateInstanceExtensionProperties>(
+		get_proc(nullptr, "vkEnumerateInstanceExtensionProperties"));
+	if (!enumerate)
+		return false;
+	u32 count = 0;
+	enumerate(nullptr, &count, nullptr);
+	std::vector<VkExtensionProperties> extensions(count);
+	enumerate(nullptr, &count, extensions.data());
+	return std::ranges::any_of(extensions, [](const VkExtensionProperties& ext) {
+		return !strcmp(ext.extensionName, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+	});
+}
+
+std::unique_ptr<Render> create_render(uvec2 size) {
+	PFN_vkGetInstanceProcAddr get_proc = load_vulkan();
+	if (!get_proc) {
+		Log::warn("No Vulkan loader found");
+		return nullptr;
+	}
+	if (!has_headless_surface(get_proc)) {
+		Log::warn("Vulkan headless surfaces aren't supported");
+		return nullptr;
+	}
+
+	// The context has initialised the dispatcher with the instance by the time it asks for the surface
+	Vulkan::Context::Create vulkan_context{
+		get_proc,
+		{VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME},
+		[](VkInstance instance, VkSurfaceKHR* surface) {
+			*surface = vk::Instance(instance).createHeadlessSurfaceEXT(vk::HeadlessSurfaceCreateInfoEXT());
+		}};
+
+	try {
+		auto render = std::make_unique<Vulkan::Render>(vulkan_context);
+		render->resize(size);
+		return render;
+	} catch (const std::exception& e) {
+		Log::warn("Couldn't create a headless renderer", e.what());
+		return nullptr;
+	}
+}
+
+ModelCache::index add_box(ModelCache& cache, f32 size, ModelCache::index material) {
+	f32 half = size / 2;
+	ModelCache::Model model;
+	model.nodes.push_back({});
+	model.meshes.push_back(
+		{.first_vertex = cache.vertices.size(),
+		 .num_vertices = 36,
+		 .material = material,
+		 .node = 0,
+		 .radius = half * std::sqrt(3.0f)});
+
+	// Each face is two triangles wound counter-clockwise around its outward normal
+	for (u32 axis = 0; axis < 3; axis++) {
+		for (f32 sign : {1.0f, -1.0f}) {
+			vec3 normal = {0, 0, 0}, u = {0, 0, 0}, v = {0, 0, 0};
+			normal[axis] = sign;
+			// u cross v is the normal
+			u[(axis + 1) % 3] = sign;
+			v[(axis + 2) % 3] = 1;
+			auto corner = [&](f32 a, f32 b) {
+				cache.vertices.push_back({(normal + u * a + v * b) * half, normal, {a * 0.5f + 0.5f, b * 0.5f + 0.5f}});
+			};
+			corner(-1, -1);
+			corner(1, -1);
+			corner(1, 1);
+			corner(-1, -1);
+			corner(1, 1);
+			corner(-1, 1);
+		}
+	}
+
+	cache.models.push_back(model);
+	return cache.models.size() - 1;
+}
+
+} // namespace Headless
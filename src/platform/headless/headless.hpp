@@ -0,0 +1,20 @@
+#pragma once
+
+#include "model.hpp"
+#include "render.hpp"
+#include <memory>
+
+// Vulkan without a window, for the benchmarks and tests that render
+//
+// Frames go to a swapchain on a VK_EXT_headless_surface, which is never shown anywhere. The Vulkan loader is
+// opened at runtime like the SDL platform does, so these build anywhere and only need a driver to run,
+// lavapipe is enough.
+namespace Headless {
+
+// Null when there is no loader, no headless surface support or no device the renderer can use
+std::unique_ptr<Render> create_render(uvec2 size);
+
+// Adds a model of one mesh, a box with sides of the given length centred on its origin
+ModelCache::index add_box(ModelCache&, f32 size, ModelCache::index material);
+
+} // namespace Headless
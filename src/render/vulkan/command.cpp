@@ -1,8 +1,12 @@
 #include "command.hpp"
 
+#include "options.hpp"
+#include <algorithm>
+
 namespace Vulkan {
 
-Command::Command(vk::Device d, const Queue& q) : device(d), queue(q.queue) {
+Command::Command(const Device& d, const Queue& q)
+	: device(d), queue(q), frames(std::clamp<size_t>(Options::get<size_t>("frames_in_flight", size), 1, size)) {
 	for (auto& i : instances) {
 		i.pool = device.createCommandPool(vk::CommandPoolCreateInfo({}, q.family));
 		i.cmd =
@@ -10,32 +14,104 @@ Command::Command(vk::Device d, const Queue& q) : device(d), queue(q.queue) {
 				.front();
 		i.fence = device.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
 	}
+
+	u32 valid_bits = d.physical_device.getQueueFamilyProperties()[q.family].timestampValidBits;
+	if (valid_bits > 0) {
+		timestamp_period = d.physical_device.getProperties().limits.timestampPeriod / 1e6f;
+		timestamp_mask = valid_bits >= 64 ? ~u64(0) : (u64(1) << valid_bits) - 1;
+		timestamp_pool = device.createQueryPool(vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp, 2 * size));
+	}
 };
 Command::~Command() {
+	// The device has gone idle by now
+	for (auto& i : instances) {
+		for (auto& f : i.deferred)
+			f();
+	}
 	for (auto& i : instances) {
 		device.destroyCommandPool(i.pool);
 		device.destroyFence(i.fence);
+		for (auto& s : i.secondaries)
+			device.destroyCommandPool(s.pool);
 	}
+	if (timestamp_pool)
+		device.destroyQueryPool(timestamp_pool);
 }
 
 void Command::begin() {
-	auto& i = instances[++index % size];
+	auto& i = instances[++index % frames];
 	auto fence_result = device.waitForFences(i.fence, false, UINT64_MAX);
 	if (fence_result != vk::Result::eSuccess) {
 		throw new vk::LogicError(to_string(fence_result));
 	}
+	for (auto& f : i.deferred)
+		f();
+	i.deferred.clear();
+
+	if (i.timestamps_written) {
+		std::array<u64, 2> ticks;
+		auto query_result = device.getQueryPoolResults(
+			timestamp_pool, get_index() * 2, 2, sizeof(ticks), ticks.data(), sizeof(u64), vk::QueryResultFlagBits::e64);
+		if (query_result == vk::Result::eSuccess)
+			gpu_time = ((ticks[1] - ticks[0]) & timestamp_mask) * timestamp_period;
+	}
+
 	device.resetFences(i.fence);
 	device.resetCommandPool(i.pool);
+	i.arena.reset();
+	for (auto& s : i.secondaries)
+		device.resetCommandPool(s.pool);
 	i.cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+	if (timestamp_pool) {
+		i.cmd.resetQueryPool(timestamp_pool, get_index() * 2, 2);
+		i.cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, timestamp_pool, get_index() * 2);
+		i.timestamps_written = true;
+	}
 };
 
 void Command::submit() {
 	auto& i = get_active();
+	if (timestamp_pool)
+		i.cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, timestamp_pool, get_index() * 2 + 1);
 	i.cmd.end();
 	vk::CommandBufferSubmitInfo cmd_info(i.cmd);
-	queue.submit2(vk::SubmitInfo2({}, wait_semaphores, cmd_info, signal_semaphores), i.fence);
+	std::unique_lock lock(*queue.lock);
+	queue.queue.submit2(vk::SubmitInfo2({}, wait_semaphores, cmd_info, signal_semaphores), i.fence);
 	wait_semaphores.clear();
 	signal_semaphores.clear();
 }
 
+void Command::defer(std::function<void()> f) { get_active().deferred.push_back(std::move(f)); }
+
+void Command::prepare_secondaries(u32 count) {
+	auto& i = get_active();
+	while (i.secondaries.size() < count) {
+		Secondary s;
+		s.pool = device.createCommandPool(vk::CommandPoolCreateInfo({}, queue.family));
+		s.cmd =
+			device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(s.pool, vk::CommandBufferLevel::eSecondary, 1))
+				.front();
+		i.secondaries.push_back(s);
+	}
+}
+
+vk::CommandBuffer Command::begin_secondary(u32 slice, const vk::CommandBufferInheritanceRenderingInfo& rendering) {
+	vk::CommandBufferInheritanceInfo inheritance;
+	inheritance.setPNext(&rendering);
+
+	vk::CommandBuffer secondary = get_active().secondaries[slice].cmd;
+	secondary.begin(vk::CommandBufferBeginInfo(
+		vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+		&inheritance));
+	return secondary;
+}
+
+void Command::execute_secondaries(u32 count) {
+	auto buffers = allocate<vk::CommandBuffer>(count);
+	for (u32 s = 0; s < count; s++)
+		buffers[s] = get_active().secondaries[s].cmd;
+	get_active().cmd.executeCommands(buffers);
+}
+
 } // namespace Vulkan
@@ -1,29 +1,51 @@
 #pragma once
 
+#include "arena.hpp"
 #include "device.hpp"
+#include <functional>
+#include <span>
 #include <vulkan/vulkan.hpp>
 
 namespace Vulkan {
 
 class Command {
 	vk::Device device;
-	vk::Queue queue;
+	Queue queue;
 
   public:
 	size_t index = -1;
+	// The most frames that can be in flight, per frame arrays are sized for it
 	static constexpr size_t size = 3;
-	inline size_t get_index() { return index % size; }
+	// How many are used, fewer cuts latency but leaves the CPU and GPU less room to overlap
+	const size_t frames;
+	inline size_t get_index() { return index % frames; }
 
   private:
+	struct Secondary {
+		vk::CommandPool pool;
+		vk::CommandBuffer cmd;
+	};
 	struct Instance {
 		vk::CommandPool pool;
 		vk::CommandBuffer cmd;
 		vk::Fence fence;
+		bool timestamps_written = false;
+		std::vector<Secondary> secondaries;
+		// Run once this instance's fence is next waited on
+		std::vector<std::function<void()>> deferred;
+		// Reset along with the pool
+		Arena arena{64 << 10};
 	};
 
 	std::array<Instance, size> instances;
 	inline Instance& get_active() { return instances[get_index()]; }
 
+	// Two timestamps per instance, bracketing the whole command buffer
+	vk::QueryPool timestamp_pool;
+	// Milliseconds per tick, zero if the queue can't write timestamps
+	f32 timestamp_period = 0;
+	u64 timestamp_mask = 0;
+
   public:
 	operator vk::CommandBuffer() { return get_active().cmd; }
 	vk::CommandBuffer* operator->() { return &get_active().cmd; }
@@ -31,11 +53,29 @@ class Command {
 	std::vector<vk::SemaphoreSubmitInfo> wait_semaphores;
 	std::vector<vk::SemaphoreSubmitInfo> signal_semaphores;
 
-	Command(vk::Device d, const Queue& q);
+	// Milliseconds the GPU spent on the last command buffer to finish
+	f32 gpu_time = 0;
+
+	Command(const Device& d, const Queue& q);
 	~Command();
 
 	void begin();
 	void submit();
+
+	// Secondary command buffers for recording slices of the frame in parallel.
+	// Every slice has its own pool per frame in flight, so each can be recorded on a different thread.
+	// prepare_secondaries is called first from the recording thread, begin_secondary from any thread.
+	void prepare_secondaries(u32 count);
+	vk::CommandBuffer begin_secondary(u32 slice, const vk::CommandBufferInheritanceRenderingInfo&);
+	// Runs the first count secondaries in slice order
+	void execute_secondaries(u32 count);
+
+	// Scratch memory for recording the frame, e.g. barrier and submit lists, kept until its fence has signalled
+	template <typename T> std::span<T> allocate(size_t count) { return get_active().arena.allocate<T>(count); }
+
+	// For destroying what earlier frames may still be using, without waiting for the device to go idle.
+	// Runs once the frame being recorded has finished, and every frame before it with it.
+	void defer(std::function<void()>);
 };
 
 } // namespace Vulkan
@@ -0,0 +1,347 @@
+#include "culling.hpp"
+
+#include "shaders.hpp"
+#include "variants.hpp"
+#include <span>
+
+namespace Vulkan {
+
+constexpr u32 group_size = 64;
+constexpr u32 binding_count = 9;
+constexpr u32 visibility_binding = 8;
+
+static u32 groups(u32 count) { return (count + group_size - 1) / group_size; }
+
+Culling::Culling(
+	const Device& d, vk::DescriptorSetLayout instance_layout, vk::DescriptorSetLayout uniform_layout,
+	vk::DescriptorSetLayout pyramid_layout)
+	: device(d), bucket_first{0} {
+	{
+		std::vector<vk::DescriptorSetLayoutBinding> bindings;
+		for (u32 i = 0; i < binding_count; i++) {
+			bindings.push_back({i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute});
+		}
+		vk::DescriptorSetLayoutCreateInfo layout_info({}, bindings);
+		layout = device->createDescriptorSetLayout(layout_info);
+	}
+	{
+		std::vector<vk::DescriptorSetLayout> set_layouts = {instance_layout, layout, uniform_layout, pyramid_layout};
+		vk::PushConstantRange push_range(vk::ShaderStageFlagBits::eCompute, 0, sizeof(Constants));
+		vk::PipelineLayoutCreateInfo layout_info({}, set_layouts, push_range);
+		pipeline_layout = device->createPipelineLayout(layout_info);
+	}
+	{
+		vk::ShaderModule shader = device->createShaderModule(vk::ShaderModuleCreateInfo({}, Shaders::cull_comp));
+		for (u32 pass = 0; pass < pipelines.size(); pass++) {
+			vk::SpecializationMapEntry entry(0, 0, sizeof(u32));
+			vk::SpecializationInfo spec(1, &entry, sizeof(u32), &pass);
+			vk::PipelineShaderStageCreateInfo stage({}, vk::ShaderStageFlagBits::eCompute, shader, "main", &spec);
+			vk::ComputePipelineCreateInfo pipeline_info({}, stage, pipeline_layout);
+			pipelines[pass] = device->createComputePipeline(device.pipeline_cache, pipeline_info).value;
+		}
+		device->destroy(shader);
+	}
+}
+
+Culling::~Culling() {
+	for (auto* b : {&slot_buffer, &model_slot_buffer, &model_buffer, &bucket_buffer, &model_counts, &commands,
+					&compacted, &counters, &visibility}) {
+		b->destroy(device);
+	}
+	for (auto& r : readback) {
+		r.destroy(device);
+	}
+	for (auto p : pipelines) {
+		device->destroy(p);
+	}
+	device->destroy(pipeline_layout);
+	device->destroy(pool);
+	device->destroy(layout);
+}
+
+void Culling::set_model_cache(const ModelCache& cache, Staging& staging, Command& cmd) {
+	// The set is replaced rather than updated, earlier frames may still be using it
+	cmd.defer([&device = device, old_pool = pool,
+			   old = std::array{slot_buffer, model_slot_buffer, model_buffer, bucket_buffer, model_counts, commands,
+								compacted, counters},
+			   old_readback = readback]() mutable {
+		for (auto& b : old)
+			b.destroy(device);
+		for (auto& r : old_readback)
+			r.destroy(device);
+		device->destroy(old_pool);
+	});
+	for (auto* b : {&slot_buffer, &model_slot_buffer, &model_buffer, &bucket_buffer, &model_counts, &commands,
+					&compacted, &counters}) {
+		*b = {};
+	}
+	readback = {};
+
+	// Materials are bindless, so only the pipeline variant splits the draws
+	auto bucket_of = [&cache](const ModelCache::Model::Mesh& mesh) { return Variant::of(cache, mesh); };
+	constexpr u32 buckets = Variant::count;
+
+	// Lay the slots out bucket by bucket, so every bucket's draws are contiguous
+	// Meshes are numbered in model order, the same as the mesh table in Assets
+	struct BucketMesh {
+		u32 model;
+		u32 mesh;
+		const ModelCache::Model::Mesh* data;
+	};
+	std::vector<std::vector<BucketMesh>> bucket_meshes(buckets);
+	u32 mesh_index = 0;
+	for (u32 m = 0; m < cache.models.size(); m++) {
+		for (auto& mesh : cache.models[m].meshes) {
+			bucket_meshes[bucket_of(mesh)].push_back({m, mesh_index++, &mesh});
+		}
+	}
+
+	slots.clear();
+	bucket_first.clear();
+	std::vector<std::vector<u32>> slots_of_model(cache.models.size());
+	for (u32 b = 0; b < bucket_meshes.size(); b++) {
+		bucket_first.push_back(slots.size());
+		for (auto [m, mesh, data] : bucket_meshes[b]) {
+			slots_of_model[m].push_back(slots.size());
+			slots.push_back(GPUSlot{
+				.first_vertex = static_cast<u32>(data->first_vertex),
+				.vertex_count = static_cast<u32>(data->num_vertices),
+				.model = m,
+				.mesh = mesh,
+				.sphere = {data->center.x, data->center.y, data->center.z, data->radius},
+				.bucket = b,
+				.node = static_cast<u32>(data->node),
+			});
+		}
+	}
+	bucket_first.push_back(slots.size());
+
+	model_slots.clear();
+	models.clear();
+	max_model_slots = 0;
+	for (auto& s : slots_of_model) {
+		models.push_back({static_cast<u32>(model_slots.size()), static_cast<u32>(s.size())});
+		model_slots.insert(model_slots.end(), s.begin(), s.end());
+		max_model_slots = std::max<u32>(max_model_slots, s.size());
+	}
+
+	auto create = [this](BufferAllocation& buffer, vk::DeviceSize size, vk::BufferUsageFlags usage) {
+		vk::BufferCreateInfo buffer_info({}, std::max<vk::DeviceSize>(size, 16), usage);
+		buffer.init(device, buffer_info, vma::AllocationCreateInfo({}, vma::MemoryUsage::eAutoPreferDevice));
+	};
+	auto upload = [&](BufferAllocation& buffer, const auto& data) {
+		vk::BufferCreateInfo buffer_info(
+			{}, std::max<vk::DeviceSize>(vectorSize(data), 16),
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+		buffer.init_device_local(device, buffer_info);
+		staging.write(
+			device, data, buffer, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead);
+	};
+	upload(slot_buffer, slots);
+	upload(model_slot_buffer, model_slots);
+	upload(model_buffer, models);
+	upload(bucket_buffer, bucket_first);
+
+	constexpr auto storage = vk::BufferUsageFlagBits::eStorageBuffer;
+	constexpr auto indirect = vk::BufferUsageFlagBits::eIndirectBuffer;
+	vk::DeviceSize counters_size = (counter_header + 2 * bucket_count()) * sizeof(u32);
+	create(model_counts, models.size() * sizeof(u32), storage | vk::BufferUsageFlagBits::eTransferDst);
+	create(commands, 2 * slots.size() * sizeof(DrawCommand), storage | indirect);
+	create(compacted, 2 * slots.size() * sizeof(DrawCommand), storage | indirect);
+	create(
+		counters, counters_size,
+		storage | indirect | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst);
+
+	for (auto& r : readback) {
+		vk::BufferCreateInfo buffer_info({}, counters_size, vk::BufferUsageFlagBits::eTransferDst);
+		vma::AllocationCreateInfo alloc_info(
+			vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessRandom,
+			vma::MemoryUsage::eAutoPreferHost);
+		r.init(device, buffer_info, alloc_info);
+	}
+	readback_written = {};
+	// Slots have moved, so last frame's visibility means nothing
+	visibility_reset = true;
+
+	create_set();
+}
+
+void Culling::create_set() {
+	vk::DescriptorPoolSize pool_size(vk::DescriptorType::eStorageBuffer, binding_count);
+	vk::DescriptorPoolCreateInfo pool_info({}, 1, pool_size);
+	pool = device->createDescriptorPool(pool_info);
+
+	vk::DescriptorSetAllocateInfo set_info(pool, layout);
+	set = device->allocateDescriptorSets(set_info).front();
+
+	// Visibility is only written once it has been allocated
+	std::array<BufferAllocation*, binding_count> bindings = {
+		&slot_buffer, &model_slot_buffer, &model_buffer, &bucket_buffer, &model_counts, &commands, &compacted,
+		&counters, &visibility};
+	u32 write_count = visibility ? binding_count : visibility_binding;
+	std::array<vk::DescriptorBufferInfo, binding_count> buffer_infos;
+	std::array<vk::WriteDescriptorSet, binding_count> write_sets;
+	for (u32 i = 0; i < write_count; i++) {
+		buffer_infos[i] = vk::DescriptorBufferInfo(*bindings[i], 0, VK_WHOLE_SIZE);
+		write_sets[i] = vk::WriteDescriptorSet(set, i, 0);
+		write_sets[i].setDescriptorType(vk::DescriptorType::eStorageBuffer).setBufferInfo(buffer_infos[i]);
+	}
+	std::span<const vk::WriteDescriptorSet> writes(write_sets.data(), write_count);
+	device->updateDescriptorSets(writes, {});
+}
+
+void Culling::reserve_visibility(Command& cmd, u32 instance_count) {
+	vk::DeviceSize size = std::max<vk::DeviceSize>(instance_count, 1) * sizeof(u32);
+	if (size <= visibility_capacity)
+		return;
+
+	// Frames in flight keep the old buffer and the set pointing at it until they finish
+	cmd.defer([&device = device, old = visibility, old_pool = pool]() mutable {
+		old.destroy(device);
+		device->destroy(old_pool);
+	});
+	visibility = {};
+	visibility_capacity = std::max(visibility_capacity * 2, std::max(size, vk::DeviceSize(4096)));
+	vk::BufferCreateInfo buffer_info(
+		{}, visibility_capacity, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+	visibility.init(device, buffer_info, vma::AllocationCreateInfo({}, vma::MemoryUsage::eAutoPreferDevice));
+	// Nothing was visible in the new buffer, it is cleared before the passes read it
+	visibility_reset = true;
+	create_set();
+}
+
+Culling::Counts Culling::read_counts(size_t index) {
+	if (!readback_written[index])
+		return {};
+
+	device.allocator.invalidateAllocation(readback[index], 0, VK_WHOLE_SIZE);
+	const u32* values = static_cast<const u32*>(readback[index].ptr);
+	Counts counts{.visible = values[0], .culled = values[1], .occluded = values[2]};
+	for (size_t b = 0; b < 2 * bucket_count(); b++) {
+		counts.draws += values[counter_header + b];
+	}
+	return counts;
+}
+
+constexpr auto compute = vk::PipelineStageFlagBits2::eComputeShader;
+constexpr auto storage_rw = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite;
+
+static void barrier(
+	Command& cmd, vk::PipelineStageFlags2 src_stage, vk::AccessFlags2 src_access, vk::PipelineStageFlags2 dst_stage,
+	vk::AccessFlags2 dst_access) {
+	vk::MemoryBarrier2 memory(src_stage, src_access, dst_stage, dst_access);
+	cmd->pipelineBarrier2(vk::DependencyInfo({}, memory));
+}
+
+void Culling::bind(Command& cmd) {
+	cmd->bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout, 0, frame_sets, uniform_offset);
+	cmd->pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Constants), &constants);
+}
+
+// Each pass waits for the one before, and the draws they leave wait for all of them
+static void run_passes(Command& cmd, std::span<const vk::Pipeline> pipelines, std::span<const u32> groups) {
+	for (size_t pass = 0; pass < groups.size(); pass++) {
+		if (pass > 0)
+			barrier(cmd, compute, vk::AccessFlagBits2::eShaderStorageWrite, compute, storage_rw);
+		cmd->bindPipeline(vk::PipelineBindPoint::eCompute, pipelines[pass]);
+		cmd->dispatch(groups[pass], 1, 1);
+	}
+
+	barrier(
+		cmd, compute, vk::AccessFlagBits2::eShaderStorageWrite,
+		vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexShader |
+			vk::PipelineStageFlagBits2::eTransfer,
+		vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead |
+			vk::AccessFlagBits2::eTransferRead);
+}
+
+void Culling::cull(
+	Command& cmd, const Inputs& inputs, const Frustum& frustum, u32 instance_count, bool occlusion) {
+	if (slots.empty())
+		return;
+	reserve_visibility(cmd, instance_count);
+
+	// The previous frame may still be drawing from the buffers, and its visibility is read here
+	barrier(
+		cmd, vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eTransfer | compute,
+		vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eTransfer | compute,
+		vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eTransferWrite);
+	cmd->fillBuffer(model_counts, 0, VK_WHOLE_SIZE, 0);
+	cmd->fillBuffer(counters, 0, VK_WHOLE_SIZE, 0);
+	if (visibility_reset) {
+		cmd->fillBuffer(visibility, 0, VK_WHOLE_SIZE, 0);
+		visibility_reset = false;
+	}
+	barrier(cmd, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, compute, storage_rw);
+
+	constants = Constants{
+		.instance_count = instance_count,
+		.slot_count = static_cast<u32>(slots.size()),
+		.model_count = static_cast<u32>(models.size()),
+		.bucket_count = static_cast<u32>(bucket_count()),
+		.occlusion = occlusion,
+	};
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), constants.planes);
+	frame_sets = {inputs.instances, set, inputs.uniform.first, inputs.pyramid};
+	uniform_offset = inputs.uniform.second;
+	bind(cmd);
+
+	std::array<u32, 4> groups_early = {groups(instance_count), 1, groups(instance_count), groups(slots.size())};
+	run_passes(cmd, std::span(pipelines).first(4), groups_early);
+
+	if (!occlusion)
+		copy_counts(cmd);
+}
+
+void Culling::cull_late(Command& cmd) {
+	if (slots.empty())
+		return;
+
+	// Building the depth pyramid bound its own sets
+	bind(cmd);
+	// The early passes only waited for drawing
+	barrier(cmd, compute, vk::AccessFlagBits2::eShaderStorageWrite, compute, storage_rw);
+
+	u32 instance_count = constants.instance_count;
+	std::array<u32, 3> groups_late = {groups(slots.size()), groups(instance_count), groups(slots.size())};
+	run_passes(cmd, std::span(pipelines).subspan(4), groups_late);
+
+	copy_counts(cmd);
+}
+
+void Culling::copy_counts(Command& cmd) {
+	size_t index = cmd.get_index();
+	cmd->copyBuffer(
+		counters, readback[index], vk::BufferCopy(0, 0, (counter_header + 2 * bucket_count()) * sizeof(u32)));
+	barrier(
+		cmd, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead);
+	readback_written[index] = true;
+}
+
+void Culling::draw(Command& cmd, size_t bucket, Phase phase) {
+	u32 first = bucket_first[bucket];
+	u32 size = bucket_first[bucket + 1] - first;
+	if (size == 0)
+		return;
+
+	// Each phase has its own draws and counts
+	u32 offset = static_cast<u32>(phase) * slots.size();
+	u32 count = counter_header + static_cast<u32>(phase) * bucket_count() + bucket;
+
+	if (!device.multi_draw_indirect) {
+		for (u32 s = offset + first; s < offset + first + size; s++) {
+			cmd->drawIndirect(commands, s * sizeof(DrawCommand), 1, sizeof(DrawCommand));
+		}
+	} else if (device.draw_indirect_count) {
+		cmd->drawIndirectCount(
+			compacted, (offset + first) * sizeof(DrawCommand), counters, count * sizeof(u32), size,
+			sizeof(DrawCommand));
+	} else {
+		// Fixed count fallback, slots without any visible instances draw nothing
+		cmd->drawIndirect(commands, (offset + first) * sizeof(DrawCommand), size, sizeof(DrawCommand));
+	}
+}
+
+} // namespace Vulkan
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "command.hpp"
+#include "device.hpp"
+#include "frustum.hpp"
+#include "model.hpp"
+#include "storage/storage.hpp"
+#include "storage/upload.hpp"
+#include <vulkan/vulkan.hpp>
+
+namespace Vulkan {
+
+// GPU driven drawing, the CPU only writes the instances and a few constants each frame.
+//
+// Every mesh of every model gets a draw slot, grouped into buckets that are drawn with the same state.
+// A chain of compute passes counts instances per model, lays out the visible list, frustum culls each
+// instance and mesh into its slot, then compacts the slots that survived into per bucket indirect draws.
+//
+// With occlusion culling the frame is drawn in two phases. The early phase draws whatever passed the occlusion
+// test last frame, then the late phase tests everything else against a depth pyramid built from the early draws,
+// drawing what turns out to be visible and remembering the results for the next frame.
+class Culling {
+	const Device& device;
+
+	vk::DescriptorSetLayout layout;
+	vk::DescriptorPool pool;
+	vk::DescriptorSet set;
+	vk::PipelineLayout pipeline_layout;
+	// One per pass, picked with a specialisation constant
+	std::array<vk::Pipeline, 7> pipelines;
+
+	// These match the shader, laid out for std430
+	struct GPUSlot {
+		u32 first_vertex;
+		u32 vertex_count;
+		u32 model;
+		u32 mesh;
+		vec4 sphere;
+		u32 bucket;
+		u32 node;
+		u32 padding[2];
+	};
+	struct GPUModel {
+		u32 first_slot;
+		u32 slot_count;
+	};
+	struct Constants {
+		vec4 planes[6];
+		u32 instance_count;
+		u32 slot_count;
+		u32 model_count;
+		u32 bucket_count;
+		u32 occlusion;
+	};
+
+	// Static tables, read by the upload thread until the assets are acquired
+	std::vector<GPUSlot> slots;
+	std::vector<u32> model_slots;
+	std::vector<GPUModel> models;
+	// Where each bucket starts in the slots, with the total at the end
+	std::vector<u32> bucket_first;
+	u32 max_model_slots = 0;
+
+	BufferAllocation slot_buffer, model_slot_buffer, model_buffer, bucket_buffer;
+	// Only touched by the GPU, each frame waits for the last one before writing them
+	// The draws have room for both phases
+	BufferAllocation model_counts, commands, compacted, counters;
+	// Which of each instance's slots were visible last frame, grown with the instance count
+	BufferAllocation visibility;
+	vk::DeviceSize visibility_capacity = 0;
+	bool visibility_reset = false;
+	void reserve_visibility(Command&, u32 instance_count);
+
+	// The set is replaced rather than updated whenever a buffer changes, earlier frames may still be using it
+	void create_set();
+
+	// Kept from the early passes for the late ones
+	std::array<vk::DescriptorSet, 4> frame_sets;
+	u32 uniform_offset = 0;
+	Constants constants;
+	void bind(Command&);
+	void copy_counts(Command&);
+
+	// Copies of the counters, read once the frame has finished
+	std::array<BufferAllocation, Command::size> readback;
+	std::array<bool, Command::size> readback_written = {};
+
+  public:
+	struct DrawCommand {
+		u32 vertex_count;
+		u32 instance_count;
+		u32 first_vertex;
+		u32 first_instance;
+	};
+	// Ahead of the bucket draw counts
+	static constexpr u32 counter_header = 3;
+
+	enum class Phase : u32 { Early = 0, Late = 1 };
+
+	Culling(const Device&, vk::DescriptorSetLayout instance_layout, vk::DescriptorSetLayout uniform_layout,
+			vk::DescriptorSetLayout pyramid_layout);
+	~Culling();
+
+	// Frames still using the previous tables keep them until they finish
+	void set_model_cache(const ModelCache&, Staging&, Command&);
+	size_t bucket_count() const { return bucket_first.size() - 1; }
+	bool bucket_empty(size_t bucket) const { return bucket_first[bucket] == bucket_first[bucket + 1]; }
+
+	// Upper bound on the visible list, so it can be sized without looking at the instances
+	size_t max_visible(size_t instance_count) const { return instance_count * max_model_slots; }
+
+	struct Counts {
+		u32 visible = 0;
+		u32 culled = 0;
+		u32 occluded = 0;
+		u32 draws = 0;
+	};
+	// What the last use of this frame index produced, call after Command::begin
+	Counts read_counts(size_t index);
+
+	struct Inputs {
+		vk::DescriptorSet instances;
+		std::pair<vk::DescriptorSet, vk::DeviceSize> uniform;
+		vk::DescriptorSet pyramid;
+	};
+	// Records the early compute passes, outside of rendering
+	// Without occlusion culling they draw everything in the frustum, and there is no late phase
+	void cull(Command&, const Inputs&, const Frustum&, u32 instance_count, bool occlusion);
+	// Records the late passes, once the depth pyramid has been built from the early draws
+	void cull_late(Command&);
+	void draw(Command&, size_t bucket, Phase = Phase::Early);
+};
+
+} // namespace Vulkan
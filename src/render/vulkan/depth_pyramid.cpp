@@ -0,0 +1,163 @@
+#include "depth_pyramid.hpp"
+
+#include "shaders.hpp"
+#include <bit>
+
+namespace Vulkan {
+
+constexpr u32 group_size = 8;
+
+DepthPyramid::DepthPyramid(const Device& d) : device(d) {
+	constexpr auto compute = vk::ShaderStageFlagBits::eCompute;
+	{
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, compute),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, compute),
+		};
+		reduce_layout = device->createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, bindings));
+
+		vk::DescriptorSetLayoutBinding binding(0, vk::DescriptorType::eCombinedImageSampler, 1, compute);
+		layout = device->createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, binding));
+	}
+	{
+		pipeline_layout = device->createPipelineLayout(vk::PipelineLayoutCreateInfo({}, reduce_layout));
+
+		vk::ShaderModule shader =
+			device->createShaderModule(vk::ShaderModuleCreateInfo({}, Shaders::depth_reduce_comp));
+		vk::PipelineShaderStageCreateInfo stage({}, compute, shader, "main");
+		vk::ComputePipelineCreateInfo pipeline_info({}, stage, pipeline_layout);
+		pipeline = device->createComputePipeline(device.pipeline_cache, pipeline_info).value;
+		device->destroy(shader);
+	}
+	{
+		// Only ever read with texelFetch
+		vk::SamplerCreateInfo sampler_info;
+		sampler_info.setMagFilter(vk::Filter::eNearest)
+			.setMinFilter(vk::Filter::eNearest)
+			.setMipmapMode(vk::SamplerMipmapMode::eNearest)
+			.setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+			.setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+			.setMaxLod(VK_LOD_CLAMP_NONE);
+		sampler = device->createSampler(sampler_info);
+	}
+}
+
+DepthPyramid::~DepthPyramid() {
+	for (auto view : level_views) {
+		device->destroy(view);
+	}
+	if (image) {
+		image.destroy(device);
+	}
+	device->destroy(sampler);
+	device->destroy(pipeline);
+	device->destroy(pipeline_layout);
+	if (pool) {
+		device->destroy(pool);
+	}
+	device->destroy(layout);
+	device->destroy(reduce_layout);
+}
+
+void DepthPyramid::resize(Command& cmd, vk::ImageView depth, vk::Extent2D depth_extent) {
+	// Earlier frames may still be building or sampling the old one
+	if (image) {
+		cmd.defer([&device = device, old_pool = pool, old_views = std::move(level_views), old = image]() mutable {
+			for (auto view : old_views) {
+				device->destroy(view);
+			}
+			old.destroy(device);
+			device->destroy(old_pool);
+		});
+		image = {};
+	}
+	level_views.clear();
+
+	{
+		std::array<vk::DescriptorPoolSize, 2> pool_sizes = {
+			vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, max_levels + 1),
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, max_levels),
+		};
+		pool = device->createDescriptorPool(vk::DescriptorPoolCreateInfo({}, max_levels + 1, pool_sizes));
+
+		std::vector<vk::DescriptorSetLayout> set_layouts(max_levels, reduce_layout);
+		set_layouts.push_back(layout);
+		auto sets = device->allocateDescriptorSets(vk::DescriptorSetAllocateInfo(pool, set_layouts));
+		std::copy(sets.begin(), sets.begin() + max_levels, reduce_sets.begin());
+		sample_set = sets.back();
+	}
+
+	extent = vk::Extent2D(std::bit_floor(depth_extent.width), std::bit_floor(depth_extent.height));
+	u32 levels = std::min<u32>(std::bit_width(std::max(extent.width, extent.height)), max_levels);
+
+	vk::ImageCreateInfo image_info;
+	image_info.setImageType(vk::ImageType::e2D)
+		.setFormat(vk::Format::eR32Sfloat)
+		.setExtent(vk::Extent3D(extent, 1))
+		.setMipLevels(levels)
+		.setArrayLayers(1)
+		.setUsage(vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+	vma::AllocationCreateInfo alloc_info({}, vma::MemoryUsage::eAutoPreferDevice);
+	vk::ImageViewCreateInfo view_info;
+	view_info.setViewType(vk::ImageViewType::e2D)
+		.setFormat(vk::Format::eR32Sfloat)
+		.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor)
+		.setLevelCount(levels)
+		.setLayerCount(1);
+	image.init(device, image_info, alloc_info, view_info);
+
+	for (u32 level = 0; level < levels; level++) {
+		view_info.subresourceRange.setBaseMipLevel(level).setLevelCount(1);
+		level_views.push_back(device->createImageView(view_info));
+	}
+
+	// Reserved so the writes can point into them
+	std::vector<vk::DescriptorImageInfo> image_infos;
+	image_infos.reserve(levels * 2 + 1);
+	std::vector<vk::WriteDescriptorSet> write_sets;
+	auto write = [&](vk::DescriptorSet set, u32 binding, vk::DescriptorType type, vk::ImageView view,
+					 vk::ImageLayout image_layout) {
+		image_infos.push_back(vk::DescriptorImageInfo(sampler, view, image_layout));
+		write_sets.push_back(vk::WriteDescriptorSet(set, binding, 0));
+		write_sets.back().setDescriptorType(type).setImageInfo(image_infos.back());
+	};
+	for (u32 level = 0; level < levels; level++) {
+		if (level == 0) {
+			write(reduce_sets[level], 0, vk::DescriptorType::eCombinedImageSampler, depth,
+				  vk::ImageLayout::eShaderReadOnlyOptimal);
+		} else {
+			write(reduce_sets[level], 0, vk::DescriptorType::eCombinedImageSampler, level_views[level - 1],
+				  vk::ImageLayout::eGeneral);
+		}
+		write(reduce_sets[level], 1, vk::DescriptorType::eStorageImage, level_views[level], vk::ImageLayout::eGeneral);
+	}
+	write(sample_set, 0, vk::DescriptorType::eCombinedImageSampler, image.view, vk::ImageLayout::eGeneral);
+	device->updateDescriptorSets(write_sets, {});
+}
+
+void DepthPyramid::build(Command& cmd) {
+	constexpr auto compute = vk::PipelineStageFlagBits2::eComputeShader;
+	u32 levels = level_views.size();
+
+	// Last frame's culling may still be reading it, and the old contents aren't needed
+	vk::ImageMemoryBarrier2 image_barrier(
+		compute, {}, compute, vk::AccessFlagBits2::eShaderStorageWrite, vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image,
+		vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, levels, 0, 1));
+	cmd->pipelineBarrier2(vk::DependencyInfo({}, {}, {}, image_barrier));
+
+	// Each level reads the one before, and the culling pass reads them all after
+	vk::MemoryBarrier2 level_barrier(
+		compute, vk::AccessFlagBits2::eShaderStorageWrite, compute, vk::AccessFlagBits2::eShaderSampledRead);
+
+	cmd->bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+	for (u32 level = 0; level < levels; level++) {
+		cmd->bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout, 0, reduce_sets[level], {});
+		u32 width = std::max(extent.width >> level, 1u);
+		u32 height = std::max(extent.height >> level, 1u);
+		cmd->dispatch((width + group_size - 1) / group_size, (height + group_size - 1) / group_size, 1);
+		cmd->pipelineBarrier2(vk::DependencyInfo({}, level_barrier));
+	}
+}
+
+} // namespace Vulkan
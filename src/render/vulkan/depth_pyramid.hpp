@@ -0,0 +1,45 @@
+#pragma once
+
+#include "command.hpp"
+#include "device.hpp"
+#include "storage/storage.hpp"
+#include <vulkan/vulkan.hpp>
+
+namespace Vulkan {
+
+// Hierarchical depth for occlusion culling, each texel holds the farthest depth of the texels under it.
+// The first level is the largest power of two that fits in the depth buffer, so every later level halves exactly.
+class DepthPyramid {
+	const Device& device;
+
+	static constexpr u32 max_levels = 16;
+
+	vk::DescriptorSetLayout reduce_layout;
+	vk::DescriptorPool pool;
+	std::array<vk::DescriptorSet, max_levels> reduce_sets;
+	vk::DescriptorSet sample_set;
+	vk::PipelineLayout pipeline_layout;
+	vk::Pipeline pipeline;
+	vk::Sampler sampler;
+
+	// The view covers every level, for sampling
+	ImageAllocation image;
+	std::vector<vk::ImageView> level_views;
+	vk::Extent2D extent;
+
+  public:
+	// A single sampler of the whole pyramid, for the shaders that test against it
+	vk::DescriptorSetLayout layout;
+
+	DepthPyramid(const Device&);
+	~DepthPyramid();
+
+	// Whenever the depth buffer is recreated, the old pyramid is kept until the frames using it have finished
+	void resize(Command&, vk::ImageView depth, vk::Extent2D depth_extent);
+	// The depth buffer must be readable from compute shaders
+	void build(Command&);
+
+	vk::DescriptorSet set() const { return sample_set; }
+};
+
+} // namespace Vulkan
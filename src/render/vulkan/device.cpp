@@ -1,5 +1,8 @@
 #include "device.hpp"
 
+#include "log.hpp"
+#include "options.hpp"
+
 namespace Vulkan {
 
 const std::vector<vk::Format> valid_formats = {
@@ -20,12 +23,30 @@ struct Config {
 	vk::Format depth_format;
 	bool memory_budget = false;
 	bool memory_priority = false;
+	bool multi_draw_indirect = false;
+	bool draw_indirect_count = false;
+	bool present_wait = false;
 };
 
+vk::PresentModeKHR wanted_present_mode() {
+	std::string name = Options::get<std::string>("present_mode", "fifo_relaxed");
+	if (name == "fifo")
+		return vk::PresentModeKHR::eFifo;
+	if (name == "fifo_relaxed")
+		return vk::PresentModeKHR::eFifoRelaxed;
+	if (name == "mailbox")
+		return vk::PresentModeKHR::eMailbox;
+	if (name == "immediate")
+		return vk::PresentModeKHR::eImmediate;
+	Log::warn("Unknown present mode", name);
+	return vk::PresentModeKHR::eFifoRelaxed;
+}
+
 std::vector<Config> getConfigs(const Context& context) {
 	std::vector<vk::PhysicalDevice> physical_devices = context.instance.enumeratePhysicalDevices();
 	std::vector<Config> configs;
 	configs.reserve(physical_devices.size());
+	vk::PresentModeKHR wanted_mode = wanted_present_mode();
 
 	for (auto pd : physical_devices) {
 		if (pd.getProperties().apiVersion < VK_API_VERSION_1_3)
@@ -34,6 +55,7 @@ std::vector<Config> getConfigs(const Context& context) {
 		Config config;
 		config.physical_device = pd;
 
+		bool present_id = false;
 		{
 			for (auto ext : pd.enumerateDeviceExtensionProperties()) {
 				if (!strcmp(ext.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
@@ -42,22 +64,46 @@ std::vector<Config> getConfigs(const Context& context) {
 				if (!strcmp(ext.extensionName, VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME)) {
 					config.memory_priority = true;
 				}
+				if (!strcmp(ext.extensionName, VK_KHR_PRESENT_ID_EXTENSION_NAME)) {
+					present_id = true;
+				}
+				if (!strcmp(ext.extensionName, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+					config.present_wait = true;
+				}
 			}
+			config.present_wait = config.present_wait && present_id;
 		}
 
 		{
 			vk::StructureChain<
-				vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features,
-				vk::PhysicalDeviceMemoryPriorityFeaturesEXT>
+				vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceVulkan13Features,
+				vk::PhysicalDeviceMemoryPriorityFeaturesEXT, vk::PhysicalDevicePresentIdFeaturesKHR,
+				vk::PhysicalDevicePresentWaitFeaturesKHR>
 				features;
 			if (!config.memory_priority)
 				features.unlink<vk::PhysicalDeviceMemoryPriorityFeaturesEXT>();
+			if (!config.present_wait) {
+				features.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+				features.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+			}
 			pd.getFeatures2(&features.get());
+			auto features12 = features.get<vk::PhysicalDeviceVulkan12Features>();
+			if (!features12.timelineSemaphore)
+				continue;
+			// Bindless textures
+			if (!features12.runtimeDescriptorArray || !features12.descriptorBindingVariableDescriptorCount ||
+				!features12.descriptorBindingPartiallyBound || !features12.shaderSampledImageArrayNonUniformIndexing)
+				continue;
 			auto features13 = features.get<vk::PhysicalDeviceVulkan13Features>();
 			if (!features13.dynamicRendering || !features13.synchronization2)
 				continue;
 			if (config.memory_priority)
 				config.memory_priority = features.get<vk::PhysicalDeviceMemoryPriorityFeaturesEXT>().memoryPriority;
+			config.multi_draw_indirect = features.get().features.multiDrawIndirect;
+			config.draw_indirect_count = features12.drawIndirectCount;
+			if (config.present_wait)
+				config.present_wait = features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+					features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
 		}
 
 		{ // Pick surface format
@@ -151,22 +197,18 @@ std::vector<Config> getConfigs(const Context& context) {
 		}
 
 		{ // Pick Present Mode
+			// Fifo is the only one that is always supported
 			std::vector<vk::PresentModeKHR> modes = pd.getSurfacePresentModesKHR(context.surface);
-			bool mailbox = false, relaxed = false;
-			for (auto mode : modes) {
-				// Force Fifo for early development
-				// mailbox = mailbox || (mode == vk::PresentModeKHR::eMailbox);
-				relaxed = relaxed || (mode == vk::PresentModeKHR::eFifoRelaxed);
-			}
-			config.present_mode = mailbox ? vk::PresentModeKHR::eMailbox
-				: relaxed                 ? vk::PresentModeKHR::eFifoRelaxed
-										  : vk::PresentModeKHR::eFifo;
+			bool supported = std::find(modes.begin(), modes.end(), wanted_mode) != modes.end();
+			config.present_mode = supported ? wanted_mode : vk::PresentModeKHR::eFifo;
 		}
 
 		{ // Pick Depth Format
-			bool depth32 = static_cast<bool>(
-				pd.getFormatProperties(vk::Format::eD32Sfloat).optimalTilingFeatures &
-				vk::FormatFeatureFlagBits::eDepthStencilAttachment);
+			// It is also sampled, to build the depth pyramid for occlusion culling
+			constexpr vk::FormatFeatureFlags depth_features =
+				vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage;
+			bool depth32 = (pd.getFormatProperties(vk::Format::eD32Sfloat).optimalTilingFeatures & depth_features) ==
+				depth_features;
 
 			config.depth_format = depth32 ? vk::Format::eD32Sfloat : vk::Format::eX8D24UnormPack32;
 		}
@@ -178,6 +220,8 @@ std::vector<Config> getConfigs(const Context& context) {
 
 Device::Device(const Context& context) {
 	auto configs = getConfigs(context);
+	if (configs.empty())
+		throw vk::LogicError("No Vulkan 1.3 device with the features the renderer needs");
 	// TODO: Load choice from options
 	auto config = configs.front();
 	{
@@ -208,15 +252,35 @@ Device::Device(const Context& context) {
 		if (config.memory_priority) {
 			device_ext.push_back(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
 		}
+		if (config.present_wait) {
+			device_ext.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			device_ext.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		}
 
 		vk::StructureChain<
-			vk::DeviceCreateInfo, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceMemoryPriorityFeaturesEXT>
+			vk::DeviceCreateInfo, vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features,
+			vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceMemoryPriorityFeaturesEXT,
+			vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>
 			device_info(
-				vk::DeviceCreateInfo({}, queue_create, {}, device_ext), vk::PhysicalDeviceVulkan13Features(),
-				vk::PhysicalDeviceMemoryPriorityFeaturesEXT(true));
+				vk::DeviceCreateInfo({}, queue_create, {}, device_ext), vk::PhysicalDeviceFeatures2(),
+				vk::PhysicalDeviceVulkan12Features(), vk::PhysicalDeviceVulkan13Features(),
+				vk::PhysicalDeviceMemoryPriorityFeaturesEXT(true), vk::PhysicalDevicePresentIdFeaturesKHR(true),
+				vk::PhysicalDevicePresentWaitFeaturesKHR(true));
+		device_info.get<vk::PhysicalDeviceFeatures2>().features.setMultiDrawIndirect(config.multi_draw_indirect);
+		device_info.get<vk::PhysicalDeviceVulkan12Features>()
+			.setTimelineSemaphore(true)
+			.setRuntimeDescriptorArray(true)
+			.setDescriptorBindingVariableDescriptorCount(true)
+			.setDescriptorBindingPartiallyBound(true)
+			.setShaderSampledImageArrayNonUniformIndexing(true)
+			.setDrawIndirectCount(config.draw_indirect_count);
 		device_info.get<vk::PhysicalDeviceVulkan13Features>().setDynamicRendering(true).setSynchronization2(true);
 		if (!config.memory_priority)
 			device_info.unlink<vk::PhysicalDeviceMemoryPriorityFeaturesEXT>();
+		if (!config.present_wait) {
+			device_info.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+			device_info.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+		}
 		device = config.physical_device.createDevice(device_info.get());
 		VULKAN_HPP_DEFAULT_DISPATCHER.init(device);
 	}
@@ -224,7 +288,11 @@ Device::Device(const Context& context) {
 	physical_device = config.physical_device;
 	surface_format = config.surface_format;
 	present_mode = config.present_mode;
+	present_wait = config.present_wait;
+	Log::info("Presenting with " + vk::to_string(present_mode));
 	depth_format = config.depth_format;
+	multi_draw_indirect = config.multi_draw_indirect;
+	draw_indirect_count = config.draw_indirect_count;
 
 	graphics_queue.family = config.graphics.family;
 	graphics_queue.queue = device.getQueue(config.graphics.family, config.graphics.index);
@@ -282,8 +350,39 @@ Device::Device(const Context& context) {
 		alloc_info.setVulkanApiVersion(VK_API_VERSION_1_3);
 		allocator = vma::createAllocator(alloc_info);
 	}
+
+	{
+		// Resizable BAR, integrated and software devices all have memory that is both. Without resizable BAR
+		// discrete devices still expose a small window of it, usually 256 MiB, which buffers would quickly fill
+		vk::PhysicalDeviceMemoryProperties memory_properties = physical_device.getMemoryProperties();
+		vk::DeviceSize device_local_size = 0;
+		for (u32 i = 0; i < memory_properties.memoryHeapCount; i++) {
+			auto& heap = memory_properties.memoryHeaps[i];
+			if (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+				device_local_size = std::max(device_local_size, heap.size);
+		}
+
+		bool host_visible_device_local = false;
+		constexpr vk::MemoryPropertyFlags wanted =
+			vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostVisible;
+		for (u32 i = 0; i < memory_properties.memoryTypeCount; i++) {
+			auto& type = memory_properties.memoryTypes[i];
+			vk::DeviceSize heap_size = memory_properties.memoryHeaps[type.heapIndex].size;
+			if ((type.propertyFlags & wanted) == wanted && heap_size >= device_local_size - device_local_size / 10)
+				host_visible_device_local = true;
+		}
+
+		direct_writes = host_visible_device_local && !Options::get("force_staging", false);
+		if (direct_writes) {
+			Log::info("Writing buffers directly to device local memory");
+		}
+	}
+
+	load_pipeline_cache();
 }
 Device::~Device() {
+	save_pipeline_cache();
+	device.destroy(pipeline_cache);
 	allocator.destroy();
 	device.destroy();
 }
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "context.hpp"
+#include "fs.hpp"
 #include "types.hpp"
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <vk_mem_alloc.hpp>
 #include <vulkan/vulkan.hpp>
@@ -10,6 +13,8 @@ namespace Vulkan {
 struct Queue {
 	vk::Queue queue;
 	u32 family;
+	// Queues used from more than one thread need submissions to be externally synchronised
+	std::shared_ptr<std::mutex> lock = std::make_shared<std::mutex>();
 };
 
 struct Device {
@@ -24,6 +29,22 @@ struct Device {
 	std::optional<Queue> transfer_queue;
 
 	vma::Allocator allocator;
+	// Buffers may be written straight into device local memory, skipping staging
+	bool direct_writes;
+	// Optional features used by GPU driven drawing
+	bool multi_draw_indirect;
+	bool draw_indirect_count;
+	// Presents are numbered, and the CPU can wait for one to be shown
+	bool present_wait;
+
+	// Every pipeline is created through this, it is loaded with the device and saved when it is destroyed
+	vk::PipelineCache pipeline_cache;
+	// Whether the cache was loaded from an earlier run, for startup timings
+	bool pipeline_cache_warm = false;
+	// One file per device and driver version
+	FS::Path pipeline_cache_path() const;
+	void load_pipeline_cache();
+	void save_pipeline_cache() const;
 
 	Device(Device&) = delete;
 	Device(const Context&);
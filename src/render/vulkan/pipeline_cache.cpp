@@ -0,0 +1,111 @@
+#include "device.hpp"
+
+#include "log.hpp"
+#include "options.hpp"
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace Vulkan {
+
+namespace {
+
+// Written ahead of the driver's data, a cache for any other device or driver is thrown away
+struct CacheHeader {
+	std::array<char, 4> magic = {'G', 'S', 'P', 'C'};
+	u32 version = 1;
+	u32 vendor_id;
+	u32 device_id;
+	u32 driver_version;
+	std::array<u8, VK_UUID_SIZE> uuid;
+	u32 padding = 0;
+	u64 data_size;
+
+	CacheHeader(const vk::PhysicalDeviceProperties& properties, u64 size)
+		: vendor_id(properties.vendorID), device_id(properties.deviceID), driver_version(properties.driverVersion),
+		  data_size(size) {
+		std::copy(properties.pipelineCacheUUID.begin(), properties.pipelineCacheUUID.end(), uuid.begin());
+	}
+
+	bool matches(const CacheHeader& o) const {
+		return magic == o.magic && version == o.version && vendor_id == o.vendor_id && device_id == o.device_id &&
+			driver_version == o.driver_version && uuid == o.uuid;
+	}
+};
+
+} // namespace
+
+FS::Path Device::pipeline_cache_path() const {
+	vk::PhysicalDeviceProperties properties = physical_device.getProperties();
+	std::ostringstream name;
+	name << "pipelines-" << std::hex << std::setfill('0') << std::setw(4) << properties.vendorID << '-'
+		 << std::setw(4) << properties.deviceID << '-' << std::setw(8) << properties.driverVersion << ".bin";
+	return FS::Path(Options::get<std::string>("cache_dir", "cache")) / name.str();
+}
+
+void Device::load_pipeline_cache() {
+	vk::PhysicalDeviceProperties properties = physical_device.getProperties();
+	FS::Path path = pipeline_cache_path();
+
+	std::vector<u8> data;
+	std::ifstream file(path, std::ios::binary);
+	if (file) {
+		std::error_code error;
+		u64 file_size = std::filesystem::file_size(path, error);
+		CacheHeader expected(properties, 0);
+		CacheHeader header(properties, 0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (file && header.matches(expected)) {
+			// Checked before allocating, a corrupt size could ask for any amount of memory
+			if (error || header.data_size != file_size - sizeof(header)) {
+				Log::warn("Pipeline cache size doesn't match the file, starting empty", path.string());
+			} else {
+				data.resize(header.data_size);
+				file.read(reinterpret_cast<char*>(data.data()), data.size());
+				if (!file) {
+					Log::warn("Pipeline cache truncated, starting empty", path.string());
+					data.clear();
+				}
+			}
+		} else {
+			Log::info("Pipeline cache is for another device or driver, starting empty", path.string());
+		}
+	}
+
+	pipeline_cache = device.createPipelineCache(vk::PipelineCacheCreateInfo({}, data.size(), data.data()));
+	pipeline_cache_warm = !data.empty();
+	if (pipeline_cache_warm) {
+		Log::info("Loaded pipeline cache", path.string());
+	}
+}
+
+// Written to a temporary file first, so a crash part way through can't leave a broken cache behind
+void Device::save_pipeline_cache() const {
+	std::vector<u8> data = device.getPipelineCacheData(pipeline_cache);
+	FS::Path path = pipeline_cache_path();
+	FS::Path temporary = FS::Path(path).concat(".tmp");
+
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		CacheHeader header(physical_device.getProperties(), data.size());
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		// Closing flushes the rest, which can fail too
+		file.close();
+		if (!file) {
+			Log::warn("Couldn't write pipeline cache", temporary.string());
+			std::filesystem::remove(temporary, error);
+			return;
+		}
+	}
+	std::filesystem::rename(temporary, path, error);
+	if (error) {
+		Log::warn("Couldn't write pipeline cache", error.message());
+	}
+}
+
+} // namespace Vulkan
@@ -1,16 +1,36 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec2 uv;
+layout(location = 3) flat in uint material_index;
 
-layout(set = 1, binding = 0) uniform sampler2D tex;
+// Self illuminated materials skip lighting
+layout(constant_id = 0) const bool emissive = false;
+
+struct Material {
+	uint texture;
+	uint flags;
+};
+layout(set = 1, binding = 0) uniform sampler tex_sampler;
+layout(set = 1, binding = 1) readonly buffer _materials { Material materials[]; };
+layout(set = 1, binding = 3) uniform texture2D textures[];
 
 layout(location = 0) out vec4 colour;
 
+// A fixed sun until there is proper lighting
+const vec3 light_direction = normalize(vec3(0.4, 0.3, 1.0));
+const float ambient = 0.35;
+
 void main() {
-	vec3 normal = normalize(in_normal);
+	// The back of a double sided face is lit as its own face
+	vec3 normal = normalize(gl_FrontFacing ? in_normal : -in_normal);
+	Material material = materials[material_index];
 	// colour = vec4((vec3(1) + normal) * 0.5, 1);
 	// colour = vec4(uv, 0, 1);
-	colour = texture(tex, uv);
+	colour = texture(sampler2D(textures[nonuniformEXT(material.texture)], tex_sampler), uv);
+	if (!emissive) {
+		colour.rgb *= ambient + (1 - ambient) * max(dot(normal, light_direction), 0);
+	}
 }
@@ -6,13 +6,35 @@ layout(location = 2) in vec2 in_uv;
 
 layout(set = 0, binding = 0) uniform _ { mat4 camera; };
 
+struct Mesh {
+	uint material;
+	uint node;
+};
+layout(set = 1, binding = 2) readonly buffer _meshes { Mesh meshes[]; };
+
+struct Instance {
+	mat4 transform;
+	uint team;
+	uint model;
+	uint node_base;
+};
+layout(set = 2, binding = 0) readonly buffer _instances { Instance instances[]; };
+// Instance and mesh index
+layout(set = 2, binding = 1) readonly buffer _visible { uvec2 visible[]; };
+layout(set = 2, binding = 2) readonly buffer _transforms { mat4 transforms[]; };
+
 layout(location = 0) out vec3 out_pos;
 layout(location = 1) out vec3 out_normal;
 layout(location = 2) out vec2 out_uv;
+layout(location = 3) flat out uint out_material;
 
 void main() {
-	out_pos = in_pos;
+	uvec2 entry = visible[gl_InstanceIndex];
+	Mesh mesh = meshes[entry.y];
+	mat4 world = transforms[instances[entry.x].node_base + mesh.node];
+	out_pos = (world * vec4(in_pos, 1.0)).xyz;
 	gl_Position = camera * vec4(out_pos, 1.0);
-	out_normal = in_normal;
+	out_normal = mat3(world) * in_normal;
 	out_uv = in_uv;
+	out_material = mesh.material;
 }
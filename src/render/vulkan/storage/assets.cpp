@@ -2,101 +2,7 @@
 
 namespace Vulkan {
 
-template <class T> inline size_t vectorSize(std::vector<T> v) { return v.size() * sizeof(T); }
-
-struct Staging {
-	struct CopyBase {
-		const void* source;
-		vk::DeviceSize size;
-		vk::DeviceSize offset = 0;
-	};
-	struct CopyBuffer : CopyBase {
-		vk::Buffer dst;
-	};
-	std::vector<CopyBuffer> copy_buffers;
-	struct CopyImage : CopyBase {
-		vk::Image dst;
-		vk::Extent3D extent;
-	};
-	std::vector<CopyImage> copy_images;
-
-	BufferAllocation staging_buffer;
-
-	template <typename T> void prepare(const std::vector<T>& data, vk::Buffer buf) {
-		copy_buffers.push_back(CopyBuffer{{data.data(), vectorSize(data)}, buf});
-	}
-	template <typename T> void prepare(const std::vector<T>& data, vk::Image img, vk::Extent3D extent) {
-		copy_images.push_back(CopyImage{{data.data(), vectorSize(data)}, img, extent});
-	}
-
-	void run(const Device& device, vk::CommandBuffer cmd) {
-		vk::DeviceSize staging_size = 0;
-
-		auto pack_copies = [&staging_size](CopyBase& copy) {
-			copy.offset = staging_size;
-			staging_size += copy.size;
-		};
-		std::ranges::for_each(copy_buffers, pack_copies);
-		std::ranges::for_each(copy_images, pack_copies);
-
-		std::vector<vk::ImageMemoryBarrier2> pre_image_barriers;
-		pre_image_barriers.reserve(copy_images.size());
-		std::vector<vk::ImageMemoryBarrier2> post_image_barriers;
-		post_image_barriers.reserve(copy_images.size());
-		for (auto i : copy_images) {
-			pre_image_barriers.emplace_back();
-			pre_image_barriers.back()
-				.setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
-				.setDstAccessMask(vk::AccessFlagBits2::eTransferWrite)
-				.setNewLayout(vk::ImageLayout::eTransferDstOptimal)
-				.setImage(i.dst)
-				.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor)
-				.setLevelCount(1)
-				.setLayerCount(1);
-
-			post_image_barriers.emplace_back();
-			post_image_barriers.back()
-				.setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
-				.setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
-				.setDstStageMask(vk::PipelineStageFlagBits2::eFragmentShader)
-				.setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead)
-				.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
-				.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-				.setImage(i.dst)
-				.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor)
-				.setLevelCount(1)
-				.setLayerCount(1);
-		}
-
-		cmd.pipelineBarrier2(vk::DependencyInfo{{}, {}, {}, pre_image_barriers});
-
-		vk::BufferCreateInfo staging_create({}, staging_size, vk::BufferUsageFlagBits::eTransferSrc);
-		vma::AllocationCreateInfo staging_alloc(
-			vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
-			vma::MemoryUsage::eAutoPreferHost);
-		staging_buffer.init(device, staging_create, staging_alloc);
-
-		auto copy_to_staging = [this](CopyBase& copy) {
-			memcpy((u8*)(staging_buffer.ptr) + copy.offset, copy.source, copy.size);
-		};
-		std::ranges::for_each(copy_buffers, copy_to_staging);
-		std::ranges::for_each(copy_images, copy_to_staging);
-
-		for (auto& buffer : copy_buffers) {
-			vk::BufferCopy region(buffer.offset, 0, buffer.size);
-			cmd.copyBuffer(staging_buffer, buffer.dst, region);
-		}
-
-		for (auto& image : copy_images) {
-			vk::ImageSubresourceLayers sub(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
-			vk::BufferImageCopy region(image.offset, 0, 0, sub, {0, 0, 0}, image.extent);
-			cmd.copyBufferToImage(staging_buffer, image.dst, vk::ImageLayout::eTransferDstOptimal, region);
-		}
-		cmd.pipelineBarrier2(vk::DependencyInfo{{}, {}, {}, post_image_barriers});
-	}
-};
-
-Assets::Assets(const Device& d) : device(d), cmd(device, device.graphics_queue) {
+Assets::Assets(const Device& d) : device(d), uploader(device) {
 	{
 		constexpr auto address_mode = vk::SamplerAddressMode::eRepeat;
 
@@ -111,48 +17,108 @@ Assets::Assets(const Device& d) : device(d), cmd(device, device.graphics_queue)
 		sampler = device->createSampler(sampler_info);
 	}
 	{
-		std::vector<vk::DescriptorSetLayoutBinding> material_layout_bindings;
-		material_layout_bindings.push_back(
-			{0, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment, sampler});
-
-		vk::DescriptorSetLayoutCreateInfo material_layout_info({}, material_layout_bindings);
-		material_layout = device->createDescriptorSetLayout(material_layout_info);
+		auto limits = device.physical_device.getProperties().limits;
+		max_textures =
+			std::min({limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages, 1u << 16});
+
+		std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+			{0, vk::DescriptorType::eSampler, vk::ShaderStageFlagBits::eFragment, sampler},
+			{1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment},
+			{2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex},
+			{3, vk::DescriptorType::eSampledImage, max_textures, vk::ShaderStageFlagBits::eFragment},
+		};
+		// Only as many textures as the cache has are allocated, and unused ones are never read
+		std::vector<vk::DescriptorBindingFlags> binding_flags = {
+			{}, {}, {},
+			vk::DescriptorBindingFlagBits::eVariableDescriptorCount | vk::DescriptorBindingFlagBits::ePartiallyBound};
+
+		vk::StructureChain<vk::DescriptorSetLayoutCreateInfo, vk::DescriptorSetLayoutBindingFlagsCreateInfo>
+			layout_info(
+				vk::DescriptorSetLayoutCreateInfo({}, bindings),
+				vk::DescriptorSetLayoutBindingFlagsCreateInfo(binding_flags));
+		layout = device->createDescriptorSetLayout(layout_info.get());
 	}
 }
 Assets::~Assets() {
-	if (vertex)
-		vertex.destroy(device);
+	vertex.destroy(device);
+	materials.destroy(device);
+	meshes.destroy(device);
 	for (auto& tex : textures)
 		tex.destroy(device);
 	device->destroy(desc_pool);
-	device->destroy(material_layout);
+	device->destroy(layout);
 	device->destroy(sampler);
 }
 
-void Assets::set_model_cache(const ModelCache& models) {
-	Staging staging;
+void Assets::set_model_cache(const ModelCache& models, Staging& staging, Command& cmd) {
+	cmd.defer([&device = device, old_vertex = vertex, old_materials = materials, old_meshes = meshes,
+			   old_textures = std::move(textures), old_pool = desc_pool]() mutable {
+		old_vertex.destroy(device);
+		old_materials.destroy(device);
+		old_meshes.destroy(device);
+		for (auto& tex : old_textures)
+			tex.destroy(device);
+		device->destroy(old_pool);
+	});
+	vertex = {};
+	materials = {};
+	meshes = {};
+	textures.clear();
 
 	vk::BufferCreateInfo vertex_info(
 		{}, vectorSize(models.vertices),
 		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer);
-	vma::AllocationCreateInfo vertex_alloc({}, vma::MemoryUsage::eAutoPreferDevice);
-	vertex.init(device, vertex_info, vertex_alloc);
-	staging.prepare(models.vertices, vertex);
+	vertex.init_device_local(device, vertex_info);
+	staging.write(device, models.vertices, vertex);
 
+	material_data.clear();
+	for (auto& m : models.materials) {
+		u32 flags = (m.emissive ? GPUMaterial::emissive : 0) | (m.double_sided ? GPUMaterial::double_sided : 0);
+		material_data.push_back({static_cast<u32>(m.texture), flags});
+	}
+	mesh_data.clear();
+	model_first_mesh.clear();
+	for (auto& model : models.models) {
+		model_first_mesh.push_back(mesh_data.size());
+		for (auto& mesh : model.meshes) {
+			mesh_data.push_back({static_cast<u32>(mesh.material), static_cast<u32>(mesh.node)});
+		}
+	}
+
+	auto upload_table = [&](BufferAllocation& buffer, const auto& data, vk::PipelineStageFlags2 stage) {
+		vk::BufferCreateInfo buffer_info(
+			{}, std::max<vk::DeviceSize>(vectorSize(data), 16),
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+		buffer.init_device_local(device, buffer_info);
+		staging.write(device, data, buffer, stage, vk::AccessFlagBits2::eShaderStorageRead);
+	};
+	upload_table(materials, material_data, vk::PipelineStageFlagBits2::eFragmentShader);
+	upload_table(meshes, mesh_data, vk::PipelineStageFlagBits2::eVertexShader);
+
+	if (models.textures.size() > max_textures) {
+		throw vk::LogicError("Too many textures for one descriptor set");
+	}
 	textures.resize(models.textures.size());
 
 	{
-		vk::DescriptorPoolSize pool_size(vk::DescriptorType::eCombinedImageSampler, textures.size());
-		vk::DescriptorPoolCreateInfo pool_info({}, textures.size(), pool_size);
+		std::vector<vk::DescriptorPoolSize> pool_sizes = {
+			{vk::DescriptorType::eSampler, 1},
+			{vk::DescriptorType::eStorageBuffer, 2},
+			// Pool sizes can't be zero, even for a cache without textures
+			{vk::DescriptorType::eSampledImage, std::max<u32>(textures.size(), 1)},
+		};
+		vk::DescriptorPoolCreateInfo pool_info({}, 1, pool_sizes);
 		desc_pool = device->createDescriptorPool(pool_info);
 
-		std::vector<vk::DescriptorSetLayout> set_layouts(textures.size(), material_layout);
-		vk::DescriptorSetAllocateInfo set_info(desc_pool, set_layouts);
-		material_sets = device->allocateDescriptorSets(set_info);
+		u32 texture_count = textures.size();
+		vk::StructureChain<vk::DescriptorSetAllocateInfo, vk::DescriptorSetVariableDescriptorCountAllocateInfo>
+			set_info;
+		set_info.get().setDescriptorPool(desc_pool).setSetLayouts(layout);
+		set_info.get<vk::DescriptorSetVariableDescriptorCountAllocateInfo>().setDescriptorCounts(texture_count);
+		set = device->allocateDescriptorSets(set_info.get()).front();
 	}
 	{
-		std::vector<std::unique_ptr<vk::DescriptorImageInfo>> desc_img;
-		std::vector<vk::WriteDescriptorSet> write_sets;
+		std::vector<vk::DescriptorImageInfo> image_infos;
 
 		for (size_t i = 0; i < models.textures.size(); i++) {
 			const ModelCache::Texture& tex_data = models.textures[i];
@@ -177,22 +143,29 @@ void Assets::set_model_cache(const ModelCache& models) {
 
 			staging.prepare(tex_data.rgba, tex, extent);
 
-			desc_img.push_back(std::make_unique<vk::DescriptorImageInfo>(
-				vk::DescriptorImageInfo{{}, tex, vk::ImageLayout::eShaderReadOnlyOptimal}));
-			write_sets.push_back(vk::WriteDescriptorSet{material_sets[i], 0, 0});
-			write_sets.back()
-				.setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-				.setImageInfo(*desc_img.back());
+			image_infos.push_back({{}, tex, vk::ImageLayout::eShaderReadOnlyOptimal});
 		}
 
+		vk::DescriptorBufferInfo material_info(materials, 0, VK_WHOLE_SIZE);
+		vk::DescriptorBufferInfo mesh_info(meshes, 0, VK_WHOLE_SIZE);
+		std::array<vk::WriteDescriptorSet, 3> write_sets = {
+			vk::WriteDescriptorSet(set, 1, 0),
+			vk::WriteDescriptorSet(set, 2, 0),
+			vk::WriteDescriptorSet(set, 3, 0),
+		};
+		write_sets[0].setDescriptorType(vk::DescriptorType::eStorageBuffer).setBufferInfo(material_info);
+		write_sets[1].setDescriptorType(vk::DescriptorType::eStorageBuffer).setBufferInfo(mesh_info);
+		write_sets[2].setDescriptorType(vk::DescriptorType::eSampledImage).setImageInfo(image_infos);
 		device->updateDescriptorSets(write_sets, {});
 	}
+}
+
+void Assets::acquire(Command& cmd) {
+	if (!pending.has_value())
+		return;
 
-	cmd.begin();
-	staging.run(device, cmd);
-	cmd.submit();
-	device->waitIdle();
-	staging.staging_buffer.destroy(device);
+	uploader.acquire(cmd, pending.value());
+	pending.reset();
 }
 
 } // namespace Vulkan
@@ -4,28 +4,63 @@
 #include "device.hpp"
 #include "model.hpp"
 #include "storage.hpp"
+#include "upload.hpp"
 #include <atomic>
 
 namespace Vulkan {
 
+// These match the shaders, laid out for std430
+struct GPUMaterial {
+	u32 texture;
+	u32 flags;
+
+	static constexpr u32 emissive = 1 << 0;
+	static constexpr u32 double_sided = 1 << 1;
+};
+struct GPUMesh {
+	u32 material;
+	// Offset from the instance's first transform
+	u32 node;
+};
+
+// Everything the model cache needs on the GPU, bound once as a single bindless set:
+// the sampler, the material and mesh tables, and a variable sized array of every texture
 class Assets {
 	const Device& device;
-	Command cmd;
+	Uploader uploader;
+	// Uploads that haven't been used by a frame yet
+	std::optional<Uploader::Ticket> pending;
 
 	vk::DescriptorPool desc_pool;
+	u32 max_textures;
+
+	// Read by the upload thread until the upload is complete
+	std::vector<GPUMaterial> material_data;
+	std::vector<GPUMesh> mesh_data;
 
   public:
 	BufferAllocation vertex;
+	BufferAllocation materials;
+	BufferAllocation meshes;
 	std::vector<ImageAllocation> textures;
 
+	// Index of each model's first mesh in the mesh table, the rest follow in order
+	std::vector<u32> model_first_mesh;
+
 	vk::Sampler sampler;
-	vk::DescriptorSetLayout material_layout;
-	std::vector<vk::DescriptorSet> material_sets;
+	vk::DescriptorSetLayout layout;
+	vk::DescriptorSet set;
 
 	Assets(const Device&);
 	~Assets();
 
-	void set_model_cache(const ModelCache&);
+	// The cache is read from the upload thread, keep it unchanged until wait_uploads
+	// Call wait_uploads first, frames still using the previous assets keep them until they finish
+	void set_model_cache(const ModelCache&, Staging&, Command&);
+	void upload(Staging&& staging) { pending = uploader.submit(std::move(staging)); }
+	void wait_uploads() { uploader.wait_idle(); }
+	// Call before the first use of the assets in a frame
+	void acquire(Command&);
 };
 
 } // namespace Vulkan
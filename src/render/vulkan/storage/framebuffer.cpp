@@ -24,16 +24,21 @@ Framebuffer::~Framebuffer() {
 
 void Framebuffer::resize(uvec2 size) { swapchain.set_extent(vk::Extent2D{size.x, size.y}); }
 
-void Framebuffer::resize_frame(vk::Extent2D size) {
+void Framebuffer::resize_frame(Command& cmd, vk::Extent2D size) {
 	frame_extent = size;
 
+	if (depth_buffer) {
+		cmd.defer([&device = device, old = depth_buffer]() mutable { old.destroy(device); });
+		depth_buffer = {};
+	}
+
 	vk::ImageCreateInfo depth_info;
 	depth_info.setImageType(vk::ImageType::e2D)
 		.setFormat(device.depth_format)
 		.setExtent(vk::Extent3D(frame_extent.width, frame_extent.height, 1))
 		.setMipLevels(1)
 		.setArrayLayers(1)
-		.setUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment);
+		.setUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled);
 	vma::AllocationCreateInfo alloc_info;
 	alloc_info.setUsage(vma::MemoryUsage::eAutoPreferDevice).setPriority(1);
 	vk::ImageViewCreateInfo view_info;
@@ -45,17 +50,21 @@ void Framebuffer::resize_frame(vk::Extent2D size) {
 	depth_buffer.init(device, depth_info, alloc_info, view_info);
 }
 
-void Framebuffer::start_rendering(Command& cmd) {
+bool Framebuffer::acquire(Command& cmd) {
 	vk::Semaphore& semaphore = acquire_semaphores[cmd.get_index()];
-	image = swapchain.acquireImage(semaphore);
+	image = swapchain.acquireImage(cmd, semaphore);
 	cmd.wait_semaphores.push_back({semaphore, {}, vk::PipelineStageFlagBits2::eColorAttachmentOutput});
 
 	if (frame_extent != swapchain.get_extent()) [[unlikely]] {
-		resize_frame(swapchain.get_extent());
+		resize_frame(cmd, swapchain.get_extent());
+		return true;
 	}
+	return false;
+}
 
+void Framebuffer::start_rendering(Command& cmd, vk::RenderingFlags flags) {
 	{
-		std::vector<vk::ImageMemoryBarrier2> image_barrier(2);
+		auto image_barrier = cmd.allocate<vk::ImageMemoryBarrier2>(2);
 		image_barrier[0]
 			.setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
 			.setDstStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
@@ -77,23 +86,75 @@ void Framebuffer::start_rendering(Command& cmd) {
 		cmd->pipelineBarrier2(vk::DependencyInfo({}, {}, {}, image_barrier));
 	}
 
-	{
-		vk::Viewport viewport(0, 0, frame_extent.width, frame_extent.height, 0, 1);
-		cmd->setViewport(0, viewport);
-		vk::Rect2D scissors({0, 0}, frame_extent);
-		cmd->setScissor(0, scissors);
+	begin_rendering(cmd, flags, vk::AttachmentLoadOp::eDontCare, vk::AttachmentLoadOp::eClear);
+}
 
-		vk::RenderingAttachmentInfo colour_attachment(image, vk::ImageLayout::eColorAttachmentOptimal);
-		colour_attachment.setLoadOp(vk::AttachmentLoadOp::eDontCare).setStoreOp(vk::AttachmentStoreOp::eStore);
+void Framebuffer::begin_rendering(
+	Command& cmd, vk::RenderingFlags flags, vk::AttachmentLoadOp colour_load, vk::AttachmentLoadOp depth_load) {
+	set_viewport(cmd);
 
-		vk::RenderingAttachmentInfo depth_attachment(depth_buffer.view, vk::ImageLayout::eDepthAttachmentOptimal);
-		depth_attachment.setLoadOp(vk::AttachmentLoadOp::eClear)
-			.setClearValue(vk::ClearValue(vk::ClearDepthStencilValue(0)))
-			.setStoreOp(vk::AttachmentStoreOp::eDontCare);
+	vk::Rect2D scissors({0, 0}, frame_extent);
 
-		vk::RenderingInfo rendering_info({}, scissors, 1, 0, colour_attachment, &depth_attachment);
-		cmd->beginRendering(rendering_info);
-	}
+	vk::RenderingAttachmentInfo colour_attachment(image, vk::ImageLayout::eColorAttachmentOptimal);
+	colour_attachment.setLoadOp(colour_load).setStoreOp(vk::AttachmentStoreOp::eStore);
+
+	// Stored in case rendering is paused to read it
+	vk::RenderingAttachmentInfo depth_attachment(depth_buffer.view, vk::ImageLayout::eDepthAttachmentOptimal);
+	depth_attachment.setLoadOp(depth_load)
+		.setClearValue(vk::ClearValue(vk::ClearDepthStencilValue(0)))
+		.setStoreOp(vk::AttachmentStoreOp::eStore);
+
+	vk::RenderingInfo rendering_info(flags, scissors, 1, 0, colour_attachment, &depth_attachment);
+	cmd->beginRendering(rendering_info);
+}
+
+void Framebuffer::pause_rendering(Command& cmd) {
+	cmd->endRendering();
+
+	vk::ImageMemoryBarrier2 image_barrier(
+		vk::PipelineStageFlagBits2::eLateFragmentTests, vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead,
+		vk::ImageLayout::eDepthAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED,
+		VK_QUEUE_FAMILY_IGNORED, depth_buffer, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1));
+	cmd->pipelineBarrier2(vk::DependencyInfo({}, {}, {}, image_barrier));
+}
+
+void Framebuffer::resume_rendering(Command& cmd, vk::RenderingFlags flags) {
+	std::array<vk::ImageMemoryBarrier2, 2> image_barriers = {
+		vk::ImageMemoryBarrier2(
+			vk::PipelineStageFlagBits2::eComputeShader, {},
+			vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+			vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+			vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eDepthAttachmentOptimal,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, depth_buffer,
+			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1)),
+		// Draws in separate rendering scopes aren't ordered against each other
+		vk::ImageMemoryBarrier2(
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+			vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eColorAttachmentOptimal,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image,
+			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)),
+	};
+	cmd->pipelineBarrier2(vk::DependencyInfo({}, {}, {}, image_barriers));
+
+	begin_rendering(cmd, flags, vk::AttachmentLoadOp::eLoad, vk::AttachmentLoadOp::eLoad);
+}
+
+void Framebuffer::set_viewport(vk::CommandBuffer cmd) const {
+	vk::Viewport viewport(0, 0, frame_extent.width, frame_extent.height, 0, 1);
+	cmd.setViewport(0, viewport);
+	vk::Rect2D scissors({0, 0}, frame_extent);
+	cmd.setScissor(0, scissors);
+}
+
+vk::CommandBufferInheritanceRenderingInfo Framebuffer::inheritance() const {
+	vk::CommandBufferInheritanceRenderingInfo info;
+	info.setColorAttachmentFormats(device.surface_format.format)
+		.setDepthAttachmentFormat(device.depth_format)
+		.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+	return info;
 }
 
 void Framebuffer::present(Command& cmd) {
@@ -114,7 +175,7 @@ void Framebuffer::present(Command& cmd) {
 
 	cmd.submit();
 
-	swapchain.present(present_semaphores[cmd.get_index()], image);
+	swapchain.present(present_semaphores[cmd.get_index()], image, cmd.index + 1);
 }
 
 } // namespace Vulkan
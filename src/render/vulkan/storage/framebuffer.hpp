@@ -15,7 +15,8 @@ class Framebuffer {
 	Swapchain::Image image;
 
 	vk::Extent2D frame_extent;
-	void resize_frame(vk::Extent2D);
+	void resize_frame(Command&, vk::Extent2D);
+	void begin_rendering(Command&, vk::RenderingFlags, vk::AttachmentLoadOp colour, vk::AttachmentLoadOp depth);
 
 	ImageAllocation depth_buffer;
 
@@ -27,8 +28,28 @@ class Framebuffer {
 	~Framebuffer();
 
 	void resize(uvec2);
-	void start_rendering(Command&);
+	// Gets the image to draw to, recreating the depth buffer first when the size has changed
+	// Returns whether it was, the old one is kept until the frames using it have finished
+	bool acquire(Command&);
+	// Pass eContentsSecondaryCommandBuffers when the draws are recorded into secondaries
+	void start_rendering(Command&, vk::RenderingFlags = {});
+	// Lets compute shaders read the depth buffer part way through the frame, then carries on drawing
+	void pause_rendering(Command&);
+	void resume_rendering(Command&, vk::RenderingFlags = {});
+	// Presents are numbered by frame, the first frame is one
 	void present(Command&);
+	// Only with present wait, see PresentWaiter
+	void take_shown(std::vector<PresentWaiter::Shown>& out) { swapchain.take_shown(out); }
+	bool wait_for_presents(size_t max_waiting, std::chrono::nanoseconds timeout) {
+		return swapchain.wait_for_presents(max_waiting, timeout);
+	}
+
+	vk::Extent2D extent() const { return frame_extent; }
+	vk::ImageView depth_view() const { return depth_buffer.view; }
+
+	// Secondaries don't inherit dynamic state, so they set the viewport themselves
+	void set_viewport(vk::CommandBuffer) const;
+	vk::CommandBufferInheritanceRenderingInfo inheritance() const;
 };
 
 } // namespace Vulkan
@@ -0,0 +1,91 @@
+#include "instances.hpp"
+
+namespace Vulkan {
+
+InstanceBuffer::InstanceBuffer(const Device& d) : device(d) {
+	{
+		constexpr auto stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eCompute;
+		std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+			{0, vk::DescriptorType::eStorageBuffer, 1, stages},
+			{1, vk::DescriptorType::eStorageBuffer, 1, stages},
+			{2, vk::DescriptorType::eStorageBuffer, 1, stages},
+		};
+		vk::DescriptorSetLayoutCreateInfo layout_info({}, bindings);
+		layout = device->createDescriptorSetLayout(layout_info);
+	}
+	{
+		vk::DescriptorPoolSize pool_size(vk::DescriptorType::eStorageBuffer, 3 * Command::size);
+		vk::DescriptorPoolCreateInfo pool_info({}, Command::size, pool_size);
+		pool = device->createDescriptorPool(pool_info);
+
+		std::vector<vk::DescriptorSetLayout> set_layouts(Command::size, layout);
+		vk::DescriptorSetAllocateInfo set_info(pool, set_layouts);
+		auto sets = device->allocateDescriptorSets(set_info);
+		for (size_t i = 0; i < Command::size; i++) {
+			frames[i].set = sets[i];
+		}
+	}
+	for (size_t i = 0; i < Command::size; i++) {
+		map(i, 1, 1, 1);
+	}
+}
+
+InstanceBuffer::~InstanceBuffer() {
+	for (auto& f : frames) {
+		f.instances.allocation.destroy(device);
+		f.visible.allocation.destroy(device);
+		f.transforms.allocation.destroy(device);
+	}
+	device->destroy(pool);
+	device->destroy(layout);
+}
+
+bool InstanceBuffer::reserve(Buffer& buffer, vk::DeviceSize size) {
+	if (size <= buffer.capacity)
+		return false;
+
+	buffer.capacity = std::max(buffer.capacity * 2, std::max(size, vk::DeviceSize(4096)));
+	vk::BufferCreateInfo buffer_info({}, buffer.capacity, vk::BufferUsageFlagBits::eStorageBuffer);
+	buffer.allocation.init_mapped(device, buffer_info);
+	return true;
+}
+
+InstanceBuffer::Mapping InstanceBuffer::map(
+	size_t index, size_t instance_count, size_t visible_count, size_t transform_count) {
+	Frame& frame = frames[index];
+
+	bool instances_changed = reserve(frame.instances, instance_count * sizeof(GPUInstance));
+	bool visible_changed = reserve(frame.visible, visible_count * sizeof(uvec2));
+	bool transforms_changed = reserve(frame.transforms, transform_count * sizeof(mat4));
+
+	if (instances_changed || visible_changed || transforms_changed) {
+		vk::DescriptorBufferInfo instances_info(frame.instances.allocation, 0, VK_WHOLE_SIZE);
+		vk::DescriptorBufferInfo visible_info(frame.visible.allocation, 0, VK_WHOLE_SIZE);
+		vk::DescriptorBufferInfo transforms_info(frame.transforms.allocation, 0, VK_WHOLE_SIZE);
+		std::array<vk::WriteDescriptorSet, 3> write_sets = {
+			vk::WriteDescriptorSet(frame.set, 0, 0),
+			vk::WriteDescriptorSet(frame.set, 1, 0),
+			vk::WriteDescriptorSet(frame.set, 2, 0),
+		};
+		write_sets[0].setDescriptorType(vk::DescriptorType::eStorageBuffer).setBufferInfo(instances_info);
+		write_sets[1].setDescriptorType(vk::DescriptorType::eStorageBuffer).setBufferInfo(visible_info);
+		write_sets[2].setDescriptorType(vk::DescriptorType::eStorageBuffer).setBufferInfo(transforms_info);
+		device->updateDescriptorSets(write_sets, {});
+	}
+
+	return Mapping{
+		.set = frame.set,
+		.instances = static_cast<GPUInstance*>(frame.instances.allocation.ptr),
+		.visible = static_cast<uvec2*>(frame.visible.allocation.ptr),
+		.transforms = static_cast<mat4*>(frame.transforms.allocation.ptr),
+	};
+}
+
+void InstanceBuffer::flush(size_t index) {
+	Frame& frame = frames[index];
+	device.allocator.flushAllocation(frame.instances.allocation, 0, VK_WHOLE_SIZE);
+	device.allocator.flushAllocation(frame.visible.allocation, 0, VK_WHOLE_SIZE);
+	device.allocator.flushAllocation(frame.transforms.allocation, 0, VK_WHOLE_SIZE);
+}
+
+} // namespace Vulkan
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "command.hpp"
+#include "device.hpp"
+#include "math.hpp"
+#include "storage.hpp"
+#include <vulkan/vulkan.hpp>
+
+namespace Vulkan {
+
+// Matches Instance in the shaders, laid out for std430
+struct GPUInstance {
+	mat4 transform;
+	u32 team;
+	u32 model;
+	// Where this instance's node transforms start
+	u32 node_base;
+	u32 padding;
+};
+
+// Per frame storage buffers of what to draw, grown as needed and mapped for as long as they live
+class InstanceBuffer {
+	const Device& device;
+
+	vk::DescriptorPool pool;
+
+	struct Buffer {
+		BufferAllocation allocation;
+		vk::DeviceSize capacity = 0;
+	};
+	struct Frame {
+		vk::DescriptorSet set;
+		Buffer instances;
+		// Instance and mesh indices, grouped by draw, written by the CPU or by culling
+		Buffer visible;
+		// World matrices of every node of every instance
+		Buffer transforms;
+	};
+	std::array<Frame, Command::size> frames;
+
+	bool reserve(Buffer&, vk::DeviceSize size);
+
+  public:
+	vk::DescriptorSetLayout layout;
+
+	InstanceBuffer(const Device&);
+	~InstanceBuffer();
+
+	struct Mapping {
+		vk::DescriptorSet set;
+		GPUInstance* instances;
+		uvec2* visible;
+		mat4* transforms;
+	};
+	// The previous use of this frame index must have finished on the GPU
+	Mapping map(size_t index, size_t instance_count, size_t visible_count, size_t transform_count);
+	void flush(size_t index);
+};
+
+} // namespace Vulkan
@@ -33,6 +33,21 @@ void BufferAllocation::init(
 	alloc = r.second;
 	ptr = device.allocator.getAllocationInfo(alloc).pMappedData;
 }
+void BufferAllocation::init_device_local(const Device& device, const vk::BufferCreateInfo& buffer_info) {
+	vma::AllocationCreateInfo alloc_info({}, vma::MemoryUsage::eAutoPreferDevice);
+	if (device.direct_writes) {
+		alloc_info.setFlags(
+			vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite |
+			vma::AllocationCreateFlagBits::eHostAccessAllowTransferInstead);
+	}
+	init(device, buffer_info, alloc_info);
+}
+void BufferAllocation::init_mapped(const Device& device, const vk::BufferCreateInfo& buffer_info) {
+	vma::AllocationCreateInfo alloc_info(
+		vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
+		device.direct_writes ? vma::MemoryUsage::eAutoPreferDevice : vma::MemoryUsage::eAutoPreferHost);
+	init(device, buffer_info, alloc_info);
+}
 void BufferAllocation::destroy(const Device& device) {
 	if (buffer)
 		device.allocator.destroyBuffer(buffer, alloc);
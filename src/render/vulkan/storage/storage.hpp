@@ -29,7 +29,8 @@ struct ImageAllocation {
 struct BufferAllocation {
 	vk::Buffer buffer;
 	vma::Allocation alloc;
-	void* ptr;
+	// Only set for mapped allocations
+	void* ptr = nullptr;
 
 	explicit operator bool() { return buffer; }
 
@@ -38,6 +39,10 @@ struct BufferAllocation {
 	operator void*() { return ptr; }
 
 	void init(const Device&, const vk::BufferCreateInfo&, const vma::AllocationCreateInfo&);
+	// Maps the buffer if it can be put in host visible device local memory, and falls back to device local memory
+	void init_device_local(const Device&, const vk::BufferCreateInfo&);
+	// Always mapped, for data written by the CPU every frame
+	void init_mapped(const Device&, const vk::BufferCreateInfo&);
 
 	void destroy(const Device&);
 };
@@ -2,18 +2,112 @@
 
 namespace Vulkan {
 
+// Dragging a window edge resizes it every few milliseconds, there is no point keeping up with all of them
+constexpr std::chrono::milliseconds resize_interval(50);
+// Presents that never show, like to a minimised window, are waited on in slices so the waiter can still stop
+constexpr u64 present_wait_slice = 100'000'000;
+
+PresentWaiter::PresentWaiter(const Device& d) : device(d) {
+	if (!device.present_wait)
+		return;
+	waiting.reserve(16);
+	shown.reserve(16);
+	thread = std::thread(&PresentWaiter::thread_func, this);
+}
+
+PresentWaiter::~PresentWaiter() {
+	if (!thread.joinable())
+		return;
+	{
+		std::unique_lock lock(mutex);
+		stop = true;
+	}
+	signal.notify_all();
+	thread.join();
+}
+
+void PresentWaiter::push(vk::SwapchainKHR swapchain, u64 id) {
+	{
+		std::unique_lock lock(mutex);
+		waiting.push_back({swapchain, id});
+	}
+	signal.notify_all();
+}
+
+void PresentWaiter::retire(vk::SwapchainKHR swapchain) {
+	{
+		std::unique_lock wait_lock(wait_mutex);
+		std::unique_lock lock(mutex);
+		for (auto& w : waiting) {
+			if (w.swapchain == swapchain)
+				shown.push_back({w.id, std::nullopt});
+		}
+		std::erase_if(waiting, [swapchain](const Waiting& w) { return w.swapchain == swapchain; });
+	}
+	signal.notify_all();
+}
+
+void PresentWaiter::take_shown(std::vector<Shown>& out) {
+	std::unique_lock lock(mutex);
+	out.insert(out.end(), shown.begin(), shown.end());
+	shown.clear();
+}
+
+bool PresentWaiter::wait_until(size_t max_waiting, std::chrono::nanoseconds timeout) {
+	std::unique_lock lock(mutex);
+	return signal.wait_for(lock, timeout, [&] { return waiting.size() <= max_waiting; });
+}
+
+void PresentWaiter::thread_func() {
+	while (true) {
+		{
+			std::unique_lock lock(mutex);
+			signal.wait(lock, [this] { return stop || !waiting.empty(); });
+			if (stop)
+				return;
+		}
+		// The front may have been retired while this wasn't holding the wait lock
+		std::unique_lock wait_lock(wait_mutex);
+		Waiting next;
+		{
+			std::unique_lock lock(mutex);
+			if (waiting.empty())
+				continue;
+			next = waiting.front();
+		}
+
+		auto result = static_cast<vk::Result>(VULKAN_HPP_DEFAULT_DISPATCHER.vkWaitForPresentKHR(
+			device.device, next.swapchain, next.id, present_wait_slice));
+		auto now = std::chrono::steady_clock::now();
+		vk::resultCheck(
+			result, "vk::Device::waitForPresentKHR",
+			{vk::Result::eSuccess, vk::Result::eTimeout, vk::Result::eErrorOutOfDateKHR});
+		if (result == vk::Result::eTimeout)
+			continue;
+
+		{
+			std::unique_lock lock(mutex);
+			waiting.erase(waiting.begin());
+			// An out of date swapchain won't show anything more
+			shown.push_back({next.id, result == vk::Result::eSuccess ? std::optional(now) : std::nullopt});
+		}
+		signal.notify_all();
+	}
+}
+
 Swapchain::~Swapchain() {
+	waiter.retire(swapchain);
 	for (auto& image_view : image_views)
 		device->destroyImageView(image_view);
 
 	device->destroySwapchainKHR(swapchain);
 }
 
-void Swapchain::reconfigureSwapchain() {
-	update = false;
-
-	// Seems to work without
-	device->waitIdle();
+void Swapchain::reconfigureSwapchain(Command& cmd) {
+	out_of_date = false;
+	resized = false;
+	recreated = std::chrono::steady_clock::now();
+	extent = requested;
 
 	vk::SurfaceCapabilitiesKHR caps = device.physical_device.getSurfaceCapabilitiesKHR(surface);
 	if (caps.currentExtent != vk::Extent2D(0xFFFFFFFF, 0xFFFFFFFF) && caps.currentExtent != vk::Extent2D(0, 0)) {
@@ -44,13 +138,18 @@ void Swapchain::reconfigureSwapchain() {
 			vk::SurfaceTransformFlagBitsKHR::eIdentity, vk::CompositeAlphaFlagBitsKHR::eOpaque, device.present_mode,
 			true, old_swapchain));
 
-		if (old_swapchain)
-			device->destroySwapchainKHR(old_swapchain);
+		if (old_swapchain) {
+			cmd.defer([&device = device, &waiter = waiter, old_swapchain, old_views = std::move(image_views)] {
+				waiter.retire(old_swapchain);
+				for (auto& image_view : old_views)
+					device->destroyImageView(image_view);
+				device->destroySwapchainKHR(old_swapchain);
+			});
+		}
 	}
 	images = device->getSwapchainImagesKHR(swapchain);
 
-	for (auto& image_view : image_views)
-		device->destroyImageView(image_view);
+	image_views.clear();
 	image_views.resize(images.size());
 	for (size_t i = 0; i < image_views.size(); i++) {
 		image_views[i] = device->createImageView(vk::ImageViewCreateInfo(
@@ -59,9 +158,9 @@ void Swapchain::reconfigureSwapchain() {
 	}
 }
 
-Swapchain::Image Swapchain::acquireImage(vk::Semaphore semaphore) {
-	if (update)
-		reconfigureSwapchain();
+Swapchain::Image Swapchain::acquireImage(Command& cmd, vk::Semaphore semaphore) {
+	if (out_of_date || (resized && std::chrono::steady_clock::now() - recreated >= resize_interval))
+		reconfigureSwapchain(cmd);
 
 	u32 index;
 	auto result = device->acquireNextImageKHR(swapchain, UINT64_MAX, semaphore, nullptr, &index);
@@ -69,22 +168,31 @@ Swapchain::Image Swapchain::acquireImage(vk::Semaphore semaphore) {
 		result, "vk::Device::acquireNextImageKHR",
 		{vk::Result::eSuccess, vk::Result::eSuboptimalKHR, vk::Result::eErrorOutOfDateKHR});
 	if (result != vk::Result::eSuccess) {
-		update = true;
+		out_of_date = true;
 		if (result != vk::Result::eSuboptimalKHR)
-			return acquireImage(semaphore);
+			return acquireImage(cmd, semaphore);
 	}
 	return Swapchain::Image{index, images[index], image_views[index]};
 }
 
 void Swapchain::present(
-	const vk::ArrayProxyNoTemporaries<const vk::Semaphore>& waitSemaphores, const Swapchain::Image& image) {
+	const vk::ArrayProxyNoTemporaries<const vk::Semaphore>& waitSemaphores, const Swapchain::Image& image, u64 id) {
 	vk::PresentInfoKHR present_info(waitSemaphores, swapchain, image.index);
-	vk::Result result = device.graphics_queue.queue.presentKHR(&present_info);
+	vk::PresentIdKHR present_id(id);
+	if (device.present_wait)
+		present_info.setPNext(&present_id);
+	vk::Result result;
+	{
+		std::unique_lock lock(*device.graphics_queue.lock);
+		result = device.graphics_queue.queue.presentKHR(&present_info);
+	}
 	vk::resultCheck(
 		result, "vk::Queue::presentKHR",
 		{vk::Result::eSuccess, vk::Result::eSuboptimalKHR, vk::Result::eErrorOutOfDateKHR});
 	if (result != vk::Result::eSuccess)
-		update = true;
+		out_of_date = true;
+	if (device.present_wait)
+		waiter.push(swapchain, id);
 }
 
 } // namespace Vulkan
@@ -1,35 +1,94 @@
 #pragma once
 
+#include "command.hpp"
 #include "device.hpp"
 #include "types.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <vulkan/vulkan.hpp>
 
 namespace Vulkan {
 
+// With present wait, a thread blocks on each present in turn and stamps when it was shown.
+// Waiting on a later frame to find out instead would add however long that frame took.
+class PresentWaiter {
+	const Device& device;
+
+	struct Waiting {
+		vk::SwapchainKHR swapchain;
+		u64 id;
+	};
+
+  public:
+	// No time means it was never shown, the swapchain went out of date or was replaced first
+	struct Shown {
+		u64 id;
+		std::optional<std::chrono::steady_clock::time_point> time;
+	};
+
+  private:
+	// Kept in vectors, there are only a few at a time and they shouldn't allocate as they come and go
+	std::mutex mutex;
+	std::condition_variable signal;
+	std::vector<Waiting> waiting;
+	std::vector<Shown> shown;
+	bool stop = false;
+	// Held while blocked on a present, so its swapchain can't be destroyed meanwhile
+	std::mutex wait_mutex;
+
+	std::thread thread;
+	void thread_func();
+
+  public:
+	PresentWaiter(const PresentWaiter&) = delete;
+	// Only starts the thread with present wait
+	PresentWaiter(const Device&);
+	~PresentWaiter();
+
+	void push(vk::SwapchainKHR, u64 id);
+	// Call before destroying a swapchain, whatever is still waiting on it is given up on
+	void retire(vk::SwapchainKHR);
+	// Moves what has been shown or given up on since the last call onto the end of the list, in present order
+	void take_shown(std::vector<Shown>&);
+	// Blocks until no more than this many presents are waiting, returns false on timeout
+	bool wait_until(size_t max_waiting, std::chrono::nanoseconds timeout);
+};
+
 class Swapchain {
 	vk::SurfaceKHR surface;
 	const Device& device;
-	bool update = true;
+	// The swapchain can't be presented to any more, or doesn't match the surface
+	bool out_of_date = true;
+	// The window was resized, which only recreates the swapchain every so often while it keeps changing
+	bool resized = false;
+	std::chrono::steady_clock::time_point recreated;
+	// What the window asked for, and what the swapchain was created with
+	vk::Extent2D requested;
 	vk::Extent2D extent;
 	vk::SwapchainKHR swapchain;
 	std::vector<vk::Image> images;
 	std::vector<vk::ImageView> image_views;
+	PresentWaiter waiter;
 
-	void reconfigureSwapchain();
+	// The old swapchain is retired through the command, so frames in flight can finish with it
+	void reconfigureSwapchain(Command&);
 
   public:
 	Swapchain(const Swapchain&) = delete;
-	Swapchain(const vk::SurfaceKHR& s, const Device& d) : surface(s), device(d) {}
+	Swapchain(const vk::SurfaceKHR& s, const Device& d) : surface(s), device(d), waiter(d) {}
 	~Swapchain();
 
 	vk::Extent2D get_extent() { return extent; }
 	// Due to vulkan limits, may not actually set to this value
 	void set_extent(vk::Extent2D e) {
-		if (extent == e) {
+		if (requested == e) {
 			return;
 		}
-		extent = e;
-		update = true;
+		requested = e;
+		resized = true;
 	}
 
 	struct Image {
@@ -41,8 +100,14 @@ class Swapchain {
 		operator vk::ImageView() const { return view; }
 	};
 
-	Image acquireImage(vk::Semaphore semaphore);
-	void present(const vk::ArrayProxyNoTemporaries<const vk::Semaphore>& waitSemaphores, const Image& image);
+	Image acquireImage(Command&, vk::Semaphore semaphore);
+	// Ids must increase, they are only passed on with present wait
+	void present(const vk::ArrayProxyNoTemporaries<const vk::Semaphore>& waitSemaphores, const Image& image, u64 id);
+	// Only with present wait
+	void take_shown(std::vector<PresentWaiter::Shown>& out) { waiter.take_shown(out); }
+	bool wait_for_presents(size_t max_waiting, std::chrono::nanoseconds timeout) {
+		return waiter.wait_until(max_waiting, timeout);
+	}
 };
 
 } // namespace Vulkan
@@ -5,7 +5,8 @@ namespace Vulkan {
 UniformBuffer::UniformBuffer(const Device& d) : device(d) {
 	{
 		vk::DescriptorSetLayoutBinding layout_bind(
-			0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex);
+			0, vk::DescriptorType::eUniformBufferDynamic, 1,
+			vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eCompute);
 		vk::DescriptorSetLayoutCreateInfo layout_info({}, layout_bind);
 		uniform_layout = device->createDescriptorSetLayout(layout_info);
 	}
@@ -26,10 +27,7 @@ UniformBuffer::UniformBuffer(const Device& d) : device(d) {
 	{
 		vk::BufferCreateInfo uniform_info;
 		uniform_info.setSize(uniform_stride * Command::size).setUsage(vk::BufferUsageFlagBits::eUniformBuffer);
-		vma::AllocationCreateInfo alloc_info(
-			vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
-			vma::MemoryUsage::eAuto);
-		uniform_buffer.init(device, uniform_info, alloc_info);
+		uniform_buffer.init_mapped(device, uniform_info);
 	}
 	{
 		vk::DescriptorBufferInfo desc_buf(uniform_buffer, 0, uniform_stride);
@@ -9,6 +9,9 @@ namespace Vulkan {
 
 struct Uniform {
 	mat4 camera; // Projection * View
+	mat4 view;
+	// x and y scale of the projection, then the near plane, for projecting bounds in culling
+	vec4 projection;
 };
 
 class UniformBuffer {
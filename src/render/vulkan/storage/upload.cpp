@@ -0,0 +1,298 @@
+#include "upload.hpp"
+
+#include "jobs.hpp"
+#include "log.hpp"
+#include "options.hpp"
+
+namespace Vulkan {
+
+// Dedicated transfer families may only copy whole blocks of texels
+static bool usable_transfer_queue(const Device& device) {
+	if (!device.transfer_queue.has_value())
+		return false;
+	auto families = device.physical_device.getQueueFamilyProperties();
+	return families[device.transfer_queue->family].minImageTransferGranularity == vk::Extent3D(1, 1, 1);
+}
+
+static vk::Semaphore create_timeline(const Device& device) {
+	vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> timeline_info(
+		vk::SemaphoreCreateInfo(), vk::SemaphoreTypeCreateInfo(vk::SemaphoreType::eTimeline, 0));
+	return device->createSemaphore(timeline_info.get());
+}
+
+// Copies out of the ring need at least texel alignment
+constexpr vk::DeviceSize ring_alignment = 16;
+constexpr vk::DeviceSize min_ring_size = 1 << 20;
+// Copies into the ring are split into pieces this size across the job workers, one thread can't fill the bandwidth
+constexpr vk::DeviceSize copy_piece = 256 << 10;
+
+Uploader::Uploader(const Device& d)
+	: device(d), queue(usable_transfer_queue(device) ? device.transfer_queue.value() : device.graphics_queue),
+	  ownership_transfer(queue.family != device.graphics_queue.family) {
+	if (queue.queue == device.graphics_queue.queue) {
+		Log::info("Uploading on the graphics queue");
+	}
+
+	timeline = create_timeline(device);
+	ring_timeline = create_timeline(device);
+
+	ring_size = Options::get<vk::DeviceSize>("staging_size_mib", 32) << 20;
+	ring_size = std::max(ring_size, min_ring_size);
+	// Keep a few chunks in flight so copying into the ring overlaps with the transfers
+	max_chunk = (ring_size / 4) & ~(ring_alignment - 1);
+	{
+		vk::BufferCreateInfo ring_create({}, ring_size, vk::BufferUsageFlagBits::eTransferSrc);
+		vma::AllocationCreateInfo ring_alloc(
+			vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
+			vma::MemoryUsage::eAutoPreferHost);
+		ring.init(device, ring_create, ring_alloc);
+	}
+
+	for (auto& s : slots) {
+		s.pool = device->createCommandPool(
+			vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient, queue.family));
+		vk::CommandBufferAllocateInfo cmd_alloc(s.pool, vk::CommandBufferLevel::ePrimary, 1);
+		s.cmd = device->allocateCommandBuffers(cmd_alloc).front();
+	}
+	begin_slot();
+
+	thread = std::thread(&Uploader::thread_func, this);
+}
+
+Uploader::~Uploader() {
+	{
+		std::unique_lock lock(request_mutex);
+		stop = true;
+	}
+	request_signal.notify_one();
+	thread.join();
+
+	wait(ring_timeline, ring_value);
+
+	for (auto& s : slots) {
+		device->destroy(s.pool);
+	}
+	ring.destroy(device);
+	device->destroy(ring_timeline);
+	device->destroy(timeline);
+}
+
+Uploader::Ticket Uploader::submit(Staging&& staging) {
+	if (staging.empty())
+		return {};
+
+	Request request{.value = ++timeline_value, .staging = std::move(staging)};
+	Ticket ticket{.value = request.value};
+
+	for (auto& b : request.staging.copy_buffers) {
+		ticket.stages |= b.dst_stage;
+		if (!ownership_transfer)
+			continue;
+
+		vk::BufferMemoryBarrier2 release(
+			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eNone, {}, queue.family, device.graphics_queue.family, b.dst, 0, VK_WHOLE_SIZE);
+		request.post_buffer_barriers.push_back(release);
+
+		vk::BufferMemoryBarrier2 acquire = release;
+		acquire.setSrcStageMask(b.dst_stage)
+			.setSrcAccessMask({})
+			.setDstStageMask(b.dst_stage)
+			.setDstAccessMask(b.dst_access);
+		ticket.buffer_barriers.push_back(acquire);
+	}
+
+	for (auto& i : request.staging.copy_images) {
+		vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+		request.pre_image_barriers.emplace_back();
+		request.pre_image_barriers.back()
+			.setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
+			.setDstAccessMask(vk::AccessFlagBits2::eTransferWrite)
+			.setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+			.setImage(i.dst)
+			.setSubresourceRange(range);
+
+		vk::ImageMemoryBarrier2 release;
+		release.setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+			.setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+			.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+			.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+			.setImage(i.dst)
+			.setSubresourceRange(range);
+		ticket.stages |= vk::PipelineStageFlagBits2::eFragmentShader;
+
+		if (ownership_transfer) {
+			// The layout transition happens once, split across the release and acquire
+			release.setSrcQueueFamilyIndex(queue.family).setDstQueueFamilyIndex(device.graphics_queue.family);
+
+			vk::ImageMemoryBarrier2 acquire = release;
+			acquire.setSrcStageMask(vk::PipelineStageFlagBits2::eFragmentShader)
+				.setSrcAccessMask({})
+				.setDstStageMask(vk::PipelineStageFlagBits2::eFragmentShader)
+				.setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead);
+			ticket.image_barriers.push_back(acquire);
+		} else {
+			release.setDstStageMask(vk::PipelineStageFlagBits2::eFragmentShader)
+				.setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead);
+		}
+		request.post_image_barriers.push_back(release);
+	}
+
+	{
+		std::unique_lock lock(request_mutex);
+		requests.push_back(std::move(request));
+	}
+	request_signal.notify_one();
+
+	return ticket;
+}
+
+void Uploader::acquire(Command& cmd, const Ticket& ticket) {
+	if (ticket.value == 0)
+		return;
+
+	// The upload may not have been submitted yet, that's fine for timeline semaphores
+	cmd.wait_semaphores.push_back({timeline, ticket.value, ticket.stages});
+	if (!ticket.buffer_barriers.empty() || !ticket.image_barriers.empty())
+		cmd->pipelineBarrier2(vk::DependencyInfo({}, {}, ticket.buffer_barriers, ticket.image_barriers));
+}
+
+bool Uploader::is_complete(u64 value) { return device->getSemaphoreCounterValue(timeline) >= value; }
+
+void Uploader::wait(vk::Semaphore semaphore, u64 value) {
+	auto wait_result = device->waitSemaphores(vk::SemaphoreWaitInfo({}, semaphore, value), UINT64_MAX);
+	if (wait_result != vk::Result::eSuccess) {
+		throw vk::LogicError(to_string(wait_result));
+	}
+}
+
+void Uploader::thread_func() {
+	while (true) {
+		Request request;
+		{
+			std::unique_lock lock(request_mutex);
+			request_signal.wait(lock, [this] { return stop || !requests.empty(); });
+			if (requests.empty())
+				return;
+			request = std::move(requests.front());
+			requests.pop_front();
+		}
+		process(request);
+	}
+}
+
+void Uploader::begin_slot() {
+	Slot& slot = slots[slot_index];
+	wait(ring_timeline, slot.value);
+	device->resetCommandPool(slot.pool);
+	slot.cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+}
+
+void Uploader::flush(u64 signal_value) {
+	Slot& slot = slots[slot_index];
+	slot.cmd.end();
+	slot.value = ++ring_value;
+	regions.push_back({ring_head, slot.value});
+
+	vk::CommandBufferSubmitInfo cmd_info(slot.cmd);
+	std::vector<vk::SemaphoreSubmitInfo> signal_info = {
+		{ring_timeline, slot.value, vk::PipelineStageFlagBits2::eAllCommands}};
+	if (signal_value)
+		signal_info.push_back({timeline, signal_value, vk::PipelineStageFlagBits2::eAllCommands});
+	{
+		std::unique_lock lock(*queue.lock);
+		queue.queue.submit2(vk::SubmitInfo2({}, {}, cmd_info, signal_info));
+	}
+
+	recording = false;
+	slot_index = (slot_index + 1) % slots.size();
+	begin_slot();
+}
+
+vk::DeviceSize Uploader::allocate(vk::DeviceSize size) {
+	assert(size <= ring_size);
+	vk::DeviceSize offset = (ring_head + ring_alignment - 1) & ~(ring_alignment - 1);
+	// Allocations don't wrap, skip over the end of the ring instead
+	if (offset % ring_size + size > ring_size)
+		offset += ring_size - offset % ring_size;
+
+	while (offset + size > ring_tail + ring_size) {
+		// Space used by the recorded commands can't be reclaimed until they are submitted
+		if (recording)
+			flush();
+		if (regions.empty()) {
+			ring_tail = offset;
+			break;
+		}
+		wait(ring_timeline, regions.front().value);
+		ring_tail = regions.front().end;
+		regions.pop_front();
+	}
+
+	ring_head = offset + size;
+	return offset % ring_size;
+}
+
+void Uploader::process(Request& request) {
+	slots[slot_index].cmd.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, request.pre_image_barriers));
+	recording = true;
+
+	// Allocating may submit the active slot, so always record into the current one after writing
+	auto write = [this](const void* source, vk::DeviceSize size) {
+		vk::DeviceSize offset = allocate(size);
+		u8* target = (u8*)(ring.ptr) + offset;
+		u32 pieces = static_cast<u32>((size + copy_piece - 1) / copy_piece);
+		Jobs::parallel_for(pieces, 1, [&](u32 begin, u32 end) {
+			vk::DeviceSize from = begin * copy_piece;
+			vk::DeviceSize to = std::min(end * copy_piece, size);
+			memcpy(target + from, (const u8*)(source) + from, to - from);
+		});
+		device.allocator.flushAllocation(ring, offset, size);
+		recording = true;
+		return offset;
+	};
+
+	for (auto& buffer : request.staging.copy_buffers) {
+		for (vk::DeviceSize done = 0; done < buffer.size; done += max_chunk) {
+			vk::DeviceSize chunk = std::min(max_chunk, buffer.size - done);
+			vk::DeviceSize offset = write((const u8*)(buffer.source) + done, chunk);
+
+			vk::BufferCopy region(offset, done, chunk);
+			slots[slot_index].cmd.copyBuffer(ring, buffer.dst, region);
+		}
+	}
+
+	for (auto& image : request.staging.copy_images) {
+		vk::DeviceSize row_size = image.size / (image.extent.height * image.extent.depth);
+		vk::DeviceSize texel_size = row_size / image.extent.width;
+		u32 chunk_rows = static_cast<u32>(std::max<vk::DeviceSize>(max_chunk / row_size, 1));
+		// Rows larger than a chunk are copied a run of texels at a time
+		u32 chunk_texels = row_size > max_chunk ? static_cast<u32>(max_chunk / texel_size) : image.extent.width;
+
+		for (u32 z = 0; z < image.extent.depth; z++) {
+			for (u32 y = 0; y < image.extent.height; y += chunk_rows) {
+				u32 rows = std::min(chunk_rows, image.extent.height - y);
+				for (u32 x = 0; x < image.extent.width; x += chunk_texels) {
+					u32 texels = std::min(chunk_texels, image.extent.width - x);
+					vk::DeviceSize source_offset = (z * image.extent.height + y) * row_size + x * texel_size;
+					vk::DeviceSize offset =
+						write((const u8*)(image.source) + source_offset, rows * texels * texel_size);
+
+					vk::ImageSubresourceLayers sub(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+					vk::BufferImageCopy region(
+						offset, 0, 0, sub, {static_cast<i32>(x), static_cast<i32>(y), static_cast<i32>(z)},
+						{texels, rows, 1});
+					slots[slot_index].cmd.copyBufferToImage(
+						ring, image.dst, vk::ImageLayout::eTransferDstOptimal, region);
+				}
+			}
+		}
+	}
+
+	slots[slot_index].cmd.pipelineBarrier2(
+		vk::DependencyInfo({}, {}, request.post_buffer_barriers, request.post_image_barriers));
+	flush(request.value);
+}
+
+} // namespace Vulkan
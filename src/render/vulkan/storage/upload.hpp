@@ -0,0 +1,147 @@
+#pragma once
+
+#include "command.hpp"
+#include "device.hpp"
+#include "storage.hpp"
+#include <condition_variable>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <vulkan/vulkan.hpp>
+
+namespace Vulkan {
+
+template <class T> inline size_t vectorSize(const std::vector<T>& v) { return v.size() * sizeof(T); }
+
+// The source data must stay alive until the upload is complete
+struct Staging {
+	struct CopyBase {
+		const void* source;
+		vk::DeviceSize size;
+	};
+	struct CopyBuffer : CopyBase {
+		vk::Buffer dst;
+		// Where the graphics queue first reads the buffer
+		vk::PipelineStageFlags2 dst_stage;
+		vk::AccessFlags2 dst_access;
+	};
+	std::vector<CopyBuffer> copy_buffers;
+	struct CopyImage : CopyBase {
+		vk::Image dst;
+		vk::Extent3D extent;
+	};
+	std::vector<CopyImage> copy_images;
+
+	template <typename T>
+	void prepare(
+		const std::vector<T>& data, vk::Buffer buf,
+		vk::PipelineStageFlags2 stage = vk::PipelineStageFlagBits2::eVertexAttributeInput,
+		vk::AccessFlags2 access = vk::AccessFlagBits2::eVertexAttributeRead) {
+		copy_buffers.push_back(CopyBuffer{{data.data(), vectorSize(data)}, buf, stage, access});
+	}
+	template <typename T> void prepare(const std::vector<T>& data, vk::Image img, vk::Extent3D extent) {
+		copy_images.push_back(CopyImage{{data.data(), vectorSize(data)}, img, extent});
+	}
+
+	// Buffers that ended up host visible are written immediately, anything else is staged
+	template <typename T>
+	void write(
+		const Device& device, const std::vector<T>& data, BufferAllocation& buf,
+		vk::PipelineStageFlags2 stage = vk::PipelineStageFlagBits2::eVertexAttributeInput,
+		vk::AccessFlags2 access = vk::AccessFlagBits2::eVertexAttributeRead) {
+		if (buf.ptr) {
+			memcpy(buf.ptr, data.data(), vectorSize(data));
+			device.allocator.flushAllocation(buf, 0, VK_WHOLE_SIZE);
+		} else {
+			prepare(data, buf.buffer, stage, access);
+		}
+	}
+
+	bool empty() const { return copy_buffers.empty() && copy_images.empty(); }
+};
+
+// Records staging copies on the transfer queue, falling back to the graphics queue if there isn't one.
+// Each request signals a timeline semaphore, so the graphics queue only waits when it first uses the data.
+//
+// Copies go through a fixed size, persistently mapped ring on a dedicated upload thread.
+// Large copies are split into chunks, and ring space is recycled as each submission completes.
+// Writing a chunk into the ring is spread across the job workers.
+class Uploader {
+	const Device& device;
+	Queue queue;
+	// Uploads on a different family need their ownership released to the graphics queue
+	bool ownership_transfer;
+
+	// Signalled with the value of each request once all of its copies have landed
+	vk::Semaphore timeline;
+	u64 timeline_value = 0;
+
+	// Signalled by every submission, used to recycle ring space and command buffers
+	vk::Semaphore ring_timeline;
+	u64 ring_value = 0;
+
+	BufferAllocation ring;
+	vk::DeviceSize ring_size;
+	vk::DeviceSize max_chunk;
+	// These only ever increase, the actual offset is modulo ring_size
+	vk::DeviceSize ring_head = 0;
+	vk::DeviceSize ring_tail = 0;
+	struct Region {
+		vk::DeviceSize end;
+		u64 value;
+	};
+	std::deque<Region> regions;
+	vk::DeviceSize allocate(vk::DeviceSize size);
+
+	struct Slot {
+		vk::CommandPool pool;
+		vk::CommandBuffer cmd;
+		u64 value = 0;
+	};
+	std::array<Slot, 4> slots;
+	size_t slot_index = 0;
+	// Set when the active slot has commands that haven't been submitted
+	bool recording = false;
+	void begin_slot();
+	void flush(u64 signal_value = 0);
+
+	struct Request {
+		u64 value;
+		Staging staging;
+		std::vector<vk::ImageMemoryBarrier2> pre_image_barriers;
+		std::vector<vk::BufferMemoryBarrier2> post_buffer_barriers;
+		std::vector<vk::ImageMemoryBarrier2> post_image_barriers;
+	};
+	std::mutex request_mutex;
+	std::condition_variable request_signal;
+	std::deque<Request> requests;
+	bool stop = false;
+
+	std::thread thread;
+	void thread_func();
+	void process(Request&);
+
+	void wait(vk::Semaphore, u64 value);
+
+  public:
+	// Everything the graphics queue has to do before using an upload
+	struct Ticket {
+		u64 value = 0;
+		vk::PipelineStageFlags2 stages;
+		std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+		std::vector<vk::ImageMemoryBarrier2> image_barriers;
+	};
+
+	Uploader(const Uploader&) = delete;
+	Uploader(const Device&);
+	~Uploader();
+
+	Ticket submit(Staging&&);
+	void acquire(Command&, const Ticket&);
+
+	bool is_complete(u64 value);
+	void wait(u64 value) { wait(timeline, value); }
+	void wait_idle() { wait(timeline_value); }
+};
+
+} // namespace Vulkan
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "model.hpp"
+#include "types.hpp"
+
+namespace Vulkan {
+
+// Meshes are drawn with a pipeline per combination of material flags, picked with specialisation constants
+// and fixed function state instead of branching in the shaders
+namespace Variant {
+
+constexpr u32 double_sided = 1;
+constexpr u32 emissive = 2;
+constexpr u32 count = 4;
+
+inline u32 of(const ModelCache::Material& material) {
+	return (material.double_sided ? double_sided : 0) | (material.emissive ? emissive : 0);
+}
+inline u32 of(const ModelCache& cache, const ModelCache::Model::Mesh& mesh) {
+	return mesh.material < cache.materials.size() ? of(cache.materials[mesh.material]) : 0;
+}
+
+} // namespace Variant
+
+} // namespace Vulkan
@@ -1,18 +1,45 @@
 #include "vulkan_render.hpp"
 
+#include "jobs.hpp"
 #include "log.hpp"
+#include "options.hpp"
 #include "shaders.hpp"
+#include "variants.hpp"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <optional>
 
 namespace Vulkan {
 
-template <class T> inline size_t vectorSize(std::vector<T> v) { return v.size() * sizeof(T); }
+// Presents that never show, like to a minimised window, aren't waited on for longer than this to pace the frames
+constexpr std::chrono::milliseconds present_timeout(100);
 
 Render::Render(Context::Create c)
 	: context(c), device(context), framebuffer(context.surface, device), assets(device), uniform_buffer(device),
-	  cmd(device, device.graphics_queue) {
+	  instance_buffer(device), pyramid(device),
+	  culling(device, instance_buffer.layout, uniform_buffer.uniform_layout, pyramid.layout),
+	  gpu_culling(Options::get("gpu_culling", true)),
+	  occlusion_culling(gpu_culling && Options::get("occlusion_culling", true)), cmd(device, device.graphics_queue),
+	  min_draws_per_slice(std::max(Options::get<u32>("min_draws_per_slice", 512), 1u)),
+	  max_pending_presents(Options::get<u32>("max_pending_presents", 0)) {
+	if (gpu_culling) {
+		Log::info("Culling and building draws on the GPU");
+	}
+	if (occlusion_culling) {
+		Log::info("Occlusion culling against last frame's visible set");
+	}
+	Log::info(std::to_string(cmd.frames) + " frames in flight");
+	pending_presents.reserve(16);
+	shown_presents.reserve(16);
+	if (max_pending_presents && !device.present_wait) {
+		Log::warn("Presents can't be waited on, max_pending_presents is ignored");
+		max_pending_presents = 0;
+	}
 
 	{
-		std::vector<vk::DescriptorSetLayout> set_layouts = {uniform_buffer.uniform_layout, assets.material_layout};
+		std::vector<vk::DescriptorSetLayout> set_layouts = {
+			uniform_buffer.uniform_layout, assets.layout, instance_buffer.layout};
 		vk::PipelineLayoutCreateInfo layout_info({}, set_layouts);
 		pipeline_layout = device->createPipelineLayout(layout_info);
 	}
@@ -21,9 +48,6 @@ Render::Render(Context::Create c)
 			device->createShaderModule(vk::ShaderModuleCreateInfo({}, Shaders::default_vert));
 		vk::ShaderModule fragment_shader =
 			device->createShaderModule(vk::ShaderModuleCreateInfo({}, Shaders::default_frag));
-		std::vector<vk::PipelineShaderStageCreateInfo> stages = {
-			vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertex_shader, "main"),
-			vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragment_shader, "main")};
 
 		std::vector<vk::VertexInputBindingDescription> bindings = {
 			vk::VertexInputBindingDescription(0, sizeof(ModelCache::Vertex))};
@@ -38,9 +62,6 @@ Render::Render(Context::Create c)
 
 		vk::PipelineViewportStateCreateInfo viewport({}, 1, nullptr, 1, nullptr);
 
-		vk::PipelineRasterizationStateCreateInfo raster;
-		raster.setLineWidth(1.0);
-
 		vk::PipelineMultisampleStateCreateInfo multisample;
 
 		vk::PipelineDepthStencilStateCreateInfo depth({}, true, true, vk::CompareOp::eGreater);
@@ -55,24 +76,52 @@ Render::Render(Context::Create c)
 		std::vector<vk::DynamicState> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
 		vk::PipelineDynamicStateCreateInfo dynamic({}, dynamicStates);
 
-		vk::StructureChain<vk::GraphicsPipelineCreateInfo, vk::PipelineRenderingCreateInfo> pipeline_create;
-		pipeline_create.get()
-			.setStages(stages)
-			.setPVertexInputState(&vertex_state)
-			.setPInputAssemblyState(&assembly_state)
-			.setPViewportState(&viewport)
-			.setPRasterizationState(&raster)
-			.setPMultisampleState(&multisample)
-			.setPDepthStencilState(&depth)
-			.setPColorBlendState(&blend)
-			.setPDynamicState(&dynamic)
-			.setLayout(pipeline_layout);
-
-		pipeline_create.get<vk::PipelineRenderingCreateInfo>()
-			.setColorAttachmentFormats(device.surface_format.format)
-			.setDepthAttachmentFormat(device.depth_format);
-
-		default_pipeline = device->createGraphicsPipeline({}, pipeline_create.get()).value;
+		// Triangles are wound counter-clockwise around their face normals by the importer
+		bool cull_backfaces = Options::get("cull_backfaces", true);
+
+		// The variants only differ in a few fields, so they are built on the job workers at once
+		auto pipelines_start = std::chrono::steady_clock::now();
+		Jobs::parallel_for(Variant::count, 1, [&](u32 begin, u32 end) {
+			for (u32 variant = begin; variant < end; variant++) {
+				vk::Bool32 emissive = (variant & Variant::emissive) != 0;
+				vk::SpecializationMapEntry entry(0, 0, sizeof(vk::Bool32));
+				vk::SpecializationInfo spec(1, &entry, sizeof(vk::Bool32), &emissive);
+				std::vector<vk::PipelineShaderStageCreateInfo> stages = {
+					vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertex_shader, "main"),
+					vk::PipelineShaderStageCreateInfo(
+						{}, vk::ShaderStageFlagBits::eFragment, fragment_shader, "main", &spec)};
+
+				bool cull = cull_backfaces && !(variant & Variant::double_sided);
+				vk::PipelineRasterizationStateCreateInfo raster;
+				raster.setCullMode(cull ? vk::CullModeFlagBits::eBack : vk::CullModeFlagBits::eNone)
+					.setFrontFace(vk::FrontFace::eCounterClockwise)
+					.setLineWidth(1.0);
+
+				vk::StructureChain<vk::GraphicsPipelineCreateInfo, vk::PipelineRenderingCreateInfo> pipeline_create;
+				pipeline_create.get()
+					.setStages(stages)
+					.setPVertexInputState(&vertex_state)
+					.setPInputAssemblyState(&assembly_state)
+					.setPViewportState(&viewport)
+					.setPRasterizationState(&raster)
+					.setPMultisampleState(&multisample)
+					.setPDepthStencilState(&depth)
+					.setPColorBlendState(&blend)
+					.setPDynamicState(&dynamic)
+					.setLayout(pipeline_layout);
+
+				pipeline_create.get<vk::PipelineRenderingCreateInfo>()
+					.setColorAttachmentFormats(device.surface_format.format)
+					.setDepthAttachmentFormat(device.depth_format);
+
+				pipelines[variant] =
+					device->createGraphicsPipeline(device.pipeline_cache, pipeline_create.get()).value;
+			}
+		});
+		f32 pipelines_time =
+			std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - pipelines_start).count();
+		std::string cache = device.pipeline_cache_warm ? " with a warm cache" : " with a cold cache";
+		Log::info("Created pipelines", std::to_string(pipelines_time) + "ms" + cache);
 
 		device->destroy(vertex_shader);
 		device->destroy(fragment_shader);
@@ -82,7 +131,8 @@ Render::Render(Context::Create c)
 Render::~Render() {
 	device->waitIdle();
 
-	device->destroy(default_pipeline);
+	for (auto pipeline : pipelines)
+		device->destroy(pipeline);
 	device->destroy(pipeline_layout);
 }
 
@@ -90,38 +140,274 @@ void Render::renderFrame(FrameInfo frame_info) {
 
 	cmd.begin();
 
+	auto cpu_start = std::chrono::steady_clock::now();
+	frame_stats = {.gpu_time = cmd.gpu_time};
+
+	assets.acquire(cmd);
+	// Before any culling is recorded, as it reads the pyramid
+	if (framebuffer.acquire(cmd)) {
+		pyramid.resize(cmd, framebuffer.depth_view(), framebuffer.extent());
+	}
+
+	mat4 view, view_proj;
+	std::pair<vk::DescriptorSet, vk::DeviceSize> uniform_target;
 	{
 		const Camera& camera = frame_info.camera;
 		mat4 proj = mat4::perspective(camera.fov, aspect, camera.near_clip);
-		mat4 view = mat4::lookAt(camera.eye, camera.target, camera.up);
-		Uniform uniform{proj * view};
-		auto bind_target = uniform_buffer.update_uniform(uniform, cmd.get_index());
-		cmd->bindDescriptorSets(
-			vk::PipelineBindPoint::eGraphics, pipeline_layout, 0, bind_target.first, bind_target.second);
+		view = mat4::lookAt(camera.eye, camera.target, camera.up);
+		view_proj = proj * view;
+		Uniform uniform{view_proj, view, {proj[0][0], proj[1][1], camera.near_clip, 0}};
+		uniform_target = uniform_buffer.update_uniform(uniform, cmd.get_index());
 	}
 
-	framebuffer.start_rendering(cmd);
+	const auto& instances = frame_info.instances;
+	vk::DescriptorSet instance_set;
+	draws.clear();
+	queue.clear();
+
+	if (gpu_culling) {
+		auto counts = culling.read_counts(cmd.get_index());
+		frame_stats.draws = counts.draws;
+		frame_stats.visible = counts.visible;
+		frame_stats.culled = counts.culled;
+		frame_stats.occluded = counts.occluded;
+
+		// Only the instances are written, the visible list and the draws are built by the culling passes
+		auto mapping = instance_buffer.map(
+			cmd.get_index(), instances.size(), culling.max_visible(instances.size()), layout_transforms(instances));
+		write_instances(instances, mapping);
+		instance_buffer.flush(cmd.get_index());
+
+		culling.cull(
+			cmd, {mapping.set, uniform_target, pyramid.set()}, Frustum::fromMatrix(view_proj), instances.size(),
+			occlusion_culling);
 
-	vk::DeviceSize offset = 0;
-	cmd->bindVertexBuffers(0, assets.vertex.buffer, offset);
+		instance_set = mapping.set;
+		frame_stats.instances = instances.size();
+	} else {
+		visibility.cull(instances, Frustum::fromMatrix(view_proj));
 
-	cmd->bindPipeline(vk::PipelineBindPoint::eGraphics, default_pipeline);
+		// Group the visible instances by model, then give each mesh of the model its own range of the visible list
+		// A model's draws are sorted by its nearest instance
+		vec4 view_depth = {-view[0].z, -view[1].z, -view[2].z, -view[3].z};
+		model_count.assign(models.models.size(), 0);
+		model_depth.assign(models.models.size(), std::numeric_limits<f32>::max());
+		for (u32 i = 0; i < instances.size(); i++) {
+			ModelCache::index m = instances[i].model;
+			if (m >= models.models.size())
+				continue;
+			frame_stats.instances++;
+			if (!visibility.isVisible(i)) {
+				frame_stats.culled += models.models[m].meshes.size();
+				continue;
+			}
+			model_count[m]++;
+			model_depth[m] = std::min(model_depth[m], dot(view_depth, instances[i].transform[3]));
+		}
+		model_first.resize(models.models.size());
+		u32 visible_count = 0;
+		for (size_t m = 0; m < models.models.size(); m++) {
+			model_first[m] = visible_count;
+			visible_count += model_count[m] * models.models[m].meshes.size();
+		}
+
+		auto mapping =
+			instance_buffer.map(cmd.get_index(), instances.size(), visible_count, layout_transforms(instances));
+		write_instances(instances, mapping);
+		model_fill.assign(models.models.size(), 0);
+		for (u32 i = 0; i < instances.size(); i++) {
+			if (visibility.isVisible(i)) {
+				ModelCache::index m = instances[i].model;
+				u32 slot = model_first[m] + model_fill[m]++;
+				for (u32 k = 0; k < models.models[m].meshes.size(); k++) {
+					mapping.visible[slot + k * model_count[m]] = {i, assets.model_first_mesh[m] + k};
+				}
+			}
+		}
+		instance_buffer.flush(cmd.get_index());
+		instance_set = mapping.set;
+		frame_stats.visible = visible_count;
+
+		for (size_t m = 0; m < models.models.size(); m++) {
+			if (model_count[m] == 0)
+				continue;
+
+			auto& meshes = models.models[m].meshes;
+			for (u32 k = 0; k < meshes.size(); k++) {
+				u32 first = model_first[m] + k * model_count[m];
+				u64 key = RenderQueue::key(
+					RenderQueue::Pass::Opaque, Variant::of(models, meshes[k]), meshes[k].material, model_depth[m]);
+				queue.push(key, draws.size());
+				draws.push_back(
+					vk::DrawIndirectCommand(meshes[k].num_vertices, model_count[m], meshes[k].first_vertex, first));
+			}
+		}
+		queue.sort();
+		frame_stats.draws = draws.size();
+	}
 
-	const auto& meshes = models.models.front().meshes;
+	// Secondaries inherit none of this, so it is bound again in each of them
+	// Materials are bindless, so these are the only descriptor binds in a command buffer
+	auto bind = [&](vk::CommandBuffer target) {
+		vk::DeviceSize offset = 0;
+		target.bindVertexBuffers(0, assets.vertex.buffer, offset);
+		std::array<vk::DescriptorSet, 3> sets = {uniform_target.first, assets.set, instance_set};
+		u32 uniform_offset = uniform_target.second;
+		target.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 0, sets, uniform_offset);
+	};
+	// Records sorted draws [begin, end), only binding a pipeline when the state in the key changes
+	// Returns the number of pipeline binds
+	auto record = [&](vk::CommandBuffer target, size_t begin, size_t end) {
+		u32 binds = 0;
+		std::optional<u64> state;
+		for (auto& entry : queue.sorted().subspan(begin, end - begin)) {
+			if (state != RenderQueue::pipeline_state(entry.key)) {
+				state = RenderQueue::pipeline_state(entry.key);
+				target.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines[RenderQueue::variant(entry.key)]);
+				binds++;
+			}
+			auto& draw = draws[entry.payload];
+			target.draw(draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance);
+		}
+		return binds;
+	};
 
-	for (auto& m : meshes) {
-		cmd->bindDescriptorSets(
-			vk::PipelineBindPoint::eGraphics, pipeline_layout, 1,
-			assets.material_sets[models.materials[m.material].texture], {});
-		cmd->draw(m.num_vertices, 1, m.first_vertex, 0);
+	// Long draw lists are split into slices, recorded into secondaries on the job workers
+	u32 slices = std::min<u32>(Jobs::worker_count() + 1, draws.size() / min_draws_per_slice);
+	if (slices > 1) {
+		framebuffer.start_rendering(cmd, vk::RenderingFlagBits::eContentsSecondaryCommandBuffers);
+		cmd.prepare_secondaries(slices);
+		vk::CommandBufferInheritanceRenderingInfo inheritance = framebuffer.inheritance();
+		slice_binds.assign(slices, 0);
+		Jobs::parallel_for(slices, 1, [&](u32 begin, u32 end) {
+			for (u32 s = begin; s < end; s++) {
+				vk::CommandBuffer secondary = cmd.begin_secondary(s, inheritance);
+				framebuffer.set_viewport(secondary);
+				bind(secondary);
+				slice_binds[s] = record(secondary, draws.size() * s / slices, draws.size() * (s + 1) / slices);
+				secondary.end();
+			}
+		});
+		cmd.execute_secondaries(slices);
+		for (u32 binds : slice_binds)
+			frame_stats.pipeline_binds += binds;
+		frame_stats.descriptor_binds = slices;
+	} else {
+		framebuffer.start_rendering(cmd);
+		bind(cmd);
+		frame_stats.descriptor_binds = 1;
+		if (gpu_culling) {
+			// Culling buckets its slots by variant
+			auto draw_buckets = [&](Culling::Phase phase) {
+				for (u32 v = 0; v < Variant::count; v++) {
+					if (culling.bucket_empty(v))
+						continue;
+					cmd->bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines[v]);
+					frame_stats.pipeline_binds++;
+					culling.draw(cmd, v, phase);
+				}
+			};
+			draw_buckets(Culling::Phase::Early);
+			if (occlusion_culling) {
+				framebuffer.pause_rendering(cmd);
+				pyramid.build(cmd);
+				culling.cull_late(cmd);
+				framebuffer.resume_rendering(cmd);
+				draw_buckets(Culling::Phase::Late);
+			}
+		} else {
+			frame_stats.pipeline_binds = record(cmd, 0, draws.size());
+		}
 	}
 
 	framebuffer.present(cmd);
+	auto presented = std::chrono::steady_clock::now();
+
+	frame_stats.cpu_time = std::chrono::duration<f32, std::milli>(presented - cpu_start).count();
+
+	// Last, so waiting here lets the next frame start from fresher input
+	pace_presents(frame_info.input_time, presented);
+
+	if (cmd.index == 0) {
+		f32 startup = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - created).count();
+		std::string cache = device.pipeline_cache_warm ? ", warm pipeline cache" : ", cold pipeline cache";
+		Log::info("First frame submitted", std::to_string(startup) + "ms after the renderer was created" + cache);
+	}
+}
+
+void Render::pace_presents(
+	std::optional<std::chrono::steady_clock::time_point> input_time, std::chrono::steady_clock::time_point presented) {
+	auto record = [this](std::optional<std::chrono::steady_clock::time_point> input,
+						 std::chrono::steady_clock::time_point shown) {
+		if (!input.has_value() || frame_stats.latency_count == Stats::max_latencies)
+			return;
+		frame_stats.latencies[frame_stats.latency_count++] =
+			std::chrono::duration<f32, std::milli>(shown - input.value()).count();
+	};
+	frame_stats.latency_shown = device.present_wait;
+	if (!device.present_wait) {
+		// Only up to when the present was queued
+		record(input_time, presented);
+		return;
+	}
+
+	if (input_time.has_value())
+		pending_presents.push_back({cmd.index + 1, input_time.value()});
+	// Over the limit blocks until enough of the older ones have been shown
+	if (max_pending_presents)
+		framebuffer.wait_for_presents(max_pending_presents, present_timeout);
+
+	// The waiter stamped each present as it was shown, every one with input becomes a sample
+	// More than the frame's stats can hold are left for the next frame
+	framebuffer.take_shown(shown_presents);
+	size_t taken = 0;
+	for (; taken < shown_presents.size() && frame_stats.latency_count < Stats::max_latencies; taken++) {
+		auto& shown = shown_presents[taken];
+		auto pending = std::find_if(
+			pending_presents.begin(), pending_presents.end(), [&](const auto& p) { return p.first == shown.id; });
+		if (pending == pending_presents.end())
+			continue;
+		if (shown.time.has_value())
+			record(pending->second, shown.time.value());
+		pending_presents.erase(pending);
+	}
+	shown_presents.erase(shown_presents.begin(), shown_presents.begin() + taken);
+}
+
+size_t Render::layout_transforms(std::span<const Instance> instances) {
+	node_bases.resize(instances.size());
+	u32 count = 0;
+	for (size_t i = 0; i < instances.size(); i++) {
+		node_bases[i] = count;
+		count += transforms.nodeCount(instances[i].model);
+	}
+	return count;
+}
+
+void Render::write_instances(std::span<const Instance> instances, const InstanceBuffer::Mapping& mapping) const {
+	for (u32 i = 0; i < instances.size(); i++) {
+		mapping.instances[i] = GPUInstance{
+			.transform = instances[i].transform,
+			.team = instances[i].team,
+			.model = static_cast<u32>(instances[i].model),
+			.node_base = node_bases[i],
+		};
+	}
+	transforms.evaluate(instances, node_bases, mapping.transforms);
 }
 
 void Render::setModelCache(const ModelCache& mc) {
+	// The upload thread may still be reading the previous cache and the tables built from it
+	assets.wait_uploads();
 	models = mc;
-	assets.set_model_cache(mc);
+
+	transforms.setModelCache(models);
+	visibility.setModelCache(models);
+
+	Staging staging;
+	assets.set_model_cache(models, staging, cmd);
+	culling.set_model_cache(models, staging, cmd);
+	assets.upload(std::move(staging));
 }
 
 } // namespace Vulkan
@@ -2,16 +2,27 @@
 
 #include "command.hpp"
 #include "context.hpp"
+#include "culling.hpp"
+#include "depth_pyramid.hpp"
 #include "device.hpp"
 #include "render.hpp"
+#include "render_queue.hpp"
 #include "storage/assets.hpp"
 #include "storage/framebuffer.hpp"
+#include "storage/instances.hpp"
 #include "storage/uniform.hpp"
+#include "transforms.hpp"
+#include "variants.hpp"
+#include "visibility.hpp"
+#include <chrono>
 #include <vulkan/vulkan.hpp>
 
 namespace Vulkan {
 
 class Render final : public ::Render {
+	// Startup time to the first frame is logged, mostly to see what the pipeline cache saves
+	const std::chrono::steady_clock::time_point created = std::chrono::steady_clock::now();
+
 	const Context context;
 	const Device device;
 
@@ -20,13 +31,58 @@ class Render final : public ::Render {
 
 	Assets assets;
 	UniformBuffer uniform_buffer;
+	InstanceBuffer instance_buffer;
+	DepthPyramid pyramid;
+	Culling culling;
+	bool gpu_culling;
+	// Only on the GPU path, which keeps what was visible from frame to frame
+	bool occlusion_culling;
 
 	Command cmd;
 
 	vk::PipelineLayout pipeline_layout;
-	vk::Pipeline default_pipeline;
+	// One per Variant
+	std::array<vk::Pipeline, Variant::count> pipelines;
 
 	ModelCache models;
+	TransformStage transforms;
+	// Frustum culling for the CPU draws, the GPU path culls in its compute passes
+	VisibilityStage visibility;
+	// Where each instance's world matrices start, reused every frame
+	std::vector<u32> node_bases;
+
+	// Fills in node_bases and returns the total
+	size_t layout_transforms(std::span<const Instance>);
+	void write_instances(std::span<const Instance>, const InstanceBuffer::Mapping&) const;
+
+	// Reused every frame to group instances by model
+	std::vector<u32> model_first;
+	std::vector<u32> model_count;
+	std::vector<u32> model_fill;
+	// Draws built on the CPU, recorded straight into the frame or split across secondaries
+	std::vector<vk::DrawIndirectCommand> draws;
+	// Sorted indices into the draws
+	RenderQueue queue;
+	// Nearest instance of each model, for sorting
+	std::vector<f32> model_depth;
+	std::vector<u32> slice_binds;
+	// Below this many draws per slice, recording secondaries in parallel costs more than it saves
+	// bench_recording measures where that is
+	u32 min_draws_per_slice;
+
+	Stats frame_stats;
+
+	// Presents with input that haven't been shown yet, with when the input they reflect arrived
+	// Only tracked with present wait, without it latency is measured up to queueing the present
+	// Only a few at most, kept in vectors so they don't allocate as they come and go
+	std::vector<std::pair<u64, std::chrono::steady_clock::time_point>> pending_presents;
+	// Reported by the swapchain's waiter but not yet turned into samples
+	std::vector<PresentWaiter::Shown> shown_presents;
+	// With present wait, the next frame isn't started while more than this many are waiting, zero for no limit
+	u32 max_pending_presents;
+	// Adds to the frame's latencies, presented is when the frame's present was queued
+	void pace_presents(std::optional<std::chrono::steady_clock::time_point> input_time,
+					   std::chrono::steady_clock::time_point presented);
 
   public:
 	Render(Context::Create);
@@ -38,6 +94,7 @@ class Render final : public ::Render {
 	}
 	void renderFrame(FrameInfo) override;
 	void setModelCache(const ModelCache&) override;
+	const Stats& stats() const override { return frame_stats; }
 };
 
 } // namespace Vulkan
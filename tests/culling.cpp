@@ -0,0 +1,79 @@
+#include "headless.hpp"
+#include <cstdio>
+#include <vector>
+
+// Renders a known scene headless and checks the culling counts the renderer reports.
+//
+// CTest runs it twice, with GUIDESTONE_GPU_CULLING on and off, so the compute passes have to agree with the CPU
+// path. On the GPU the counts come from read_counts, which lags the frames in flight, so frames are rendered
+// until they show up. Occlusion culling is off, everything in the frustum is drawn.
+// Exits with 77, which CTest counts as skipped, when there is no Vulkan device that can render without a window.
+
+namespace {
+
+constexpr u32 skipped = 77;
+// Far more than the frames in flight, the model upload also has to finish first
+constexpr u32 max_frames = 100;
+
+struct Expected {
+	u32 visible, culled, draws;
+};
+
+} // namespace
+
+int main() {
+	auto render = Headless::create_render({1280, 720});
+	if (!render) {
+		std::fprintf(stderr, "No Vulkan device that can render without a window, skipping\n");
+		return skipped;
+	}
+
+	ModelCache cache;
+	cache.materials.push_back({.texture = 0});
+	ModelCache::index mostly_seen = Headless::add_box(cache, 10, 0);
+	ModelCache::index once_seen = Headless::add_box(cache, 10, 0);
+	ModelCache::index unseen = Headless::add_box(cache, 10, 0);
+	render->setModelCache(cache);
+
+	// The eye is at x = 1000 looking back along x at the origin, with z up
+	Camera camera(1000);
+	auto at = [](ModelCache::index model, vec3 pos) {
+		return Render::Instance{.model = model, .transform = mat4::translate(pos), .team = 0};
+	};
+	std::vector<Render::Instance> instances = {
+		// In view
+		at(mostly_seen, {0, 0, 0}),
+		at(mostly_seen, {-500, 0, 0}),
+		at(mostly_seen, {-1000, 0, 0}),
+		at(once_seen, {0, 200, 100}),
+		// Behind the eye
+		at(mostly_seen, {2000, 0, 0}),
+		at(once_seen, {3000, 0, 0}),
+		at(unseen, {1500, 0, 0}),
+		// Beside, above and below the frustum
+		at(mostly_seen, {0, 5000, 0}),
+		at(once_seen, {0, -5000, 0}),
+		at(once_seen, {0, 0, 3000}),
+		at(unseen, {0, 0, -3000}),
+	};
+	// One draw for each model with something in view, every box is one mesh
+	constexpr Expected expected = {.visible = 4, .culled = 7, .draws = 2};
+
+	u32 frame = 0;
+	for (; frame < max_frames; frame++) {
+		render->renderFrame({.camera = camera, .instances = instances, .input_time = {}});
+		const Render::Stats& stats = render->stats();
+		if (stats.visible + stats.culled == instances.size())
+			break;
+	}
+	if (frame == max_frames) {
+		std::fprintf(stderr, "No counts after %u frames\n", max_frames);
+		return 1;
+	}
+
+	const Render::Stats& stats = render->stats();
+	bool ok = stats.visible == expected.visible && stats.culled == expected.culled && stats.draws == expected.draws;
+	std::printf("%s after %u frames: %u visible, %u culled, %u draws, expected %u, %u and %u\n", ok ? "ok" : "FAILED",
+				frame + 1, stats.visible, stats.culled, stats.draws, expected.visible, expected.culled, expected.draws);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+#include "math.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Checks the f32 SIMD paths of math.hpp against the scalar templates on seeded random inputs.
+//
+// The two can't be in one executable, so this is built twice. With GUIDESTONE_SCALAR_MATH it writes the bits of
+// every result to the file it is given, then the normal build computes the same results and compares them.
+// The SIMD paths keep the scalar order of operations, so every bound is currently zero ULPs.
+
+namespace {
+
+constexpr u32 iterations = 100'000;
+
+struct Op {
+	const char* name;
+	u32 max_ulps;
+};
+enum : u32 {
+	Dot4,
+	Normalized3,
+	Normalized4,
+	Cross,
+	Arithmetic4,
+	MatrixVector,
+	MatrixMatrix,
+	Transpose,
+	Inverse,
+	AffineInverse,
+	LookAt,
+	Perspective,
+	Lerp,
+	op_count
+};
+constexpr std::array<Op, op_count> ops = {{
+	{"dot vec4", 0},
+	{"normalized vec3", 0},
+	{"normalized vec4", 0},
+	{"cross", 0},
+	{"vec4 arithmetic", 0},
+	{"mat4 * vec4", 0},
+	{"mat4 * mat4", 0},
+	{"transpose", 0},
+	{"inverse", 0},
+	{"affineInverse", 0},
+	{"lookAt", 0},
+	{"perspective", 0},
+	{"lerp mat4", 0},
+}};
+
+using Results = std::array<std::vector<f32>, op_count>;
+
+template <typename T> void add(Results& results, u32 op, const T& value) {
+	static_assert(sizeof(T) % sizeof(f32) == 0);
+	const f32* values = reinterpret_cast<const f32*>(&value);
+	results[op].insert(results[op].end(), values, values + sizeof(T) / sizeof(f32));
+}
+
+Results compute() {
+	Results results;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<f32> range(-100, 100), unit(-1, 1), positive(0.1f, 4);
+	auto v3 = [&] { return vec3{range(rng), range(rng), range(rng)}; };
+	auto v4 = [&] { return vec4{range(rng), range(rng), range(rng), range(rng)}; };
+	auto m4 = [&] { return mat4{v4(), v4(), v4(), v4()}; };
+	auto affine = [&] {
+		vec4 q = normalized(vec4{unit(rng), unit(rng), unit(rng), unit(rng)});
+		return mat4::fromTRS({v3(), q, {positive(rng), positive(rng), positive(rng)}});
+	};
+
+	for (u32 i = 0; i < iterations; i++) {
+		vec4 a = v4(), b = v4(), c = v4();
+		f32 s = range(rng);
+		add(results, Dot4, dot(a, b));
+		add(results, Normalized3, normalized(v3()));
+		add(results, Normalized4, normalized(a));
+		add(results, Cross, cross(v3(), v3()));
+		add(results, Arithmetic4, (a + b) * c - a / s + b * s);
+
+		mat4 m = m4(), n = m4();
+		add(results, MatrixVector, m * a);
+		add(results, MatrixMatrix, m * n);
+		add(results, Transpose, transpose(m));
+		add(results, Inverse, inverse(m));
+
+		mat4 t = affine(), u = affine();
+		add(results, AffineInverse, affineInverse(t));
+		add(results, LookAt, mat4::lookAt(v3(), v3(), normalized(v3())));
+		add(results, Perspective, mat4::perspective(positive(rng) / 2, positive(rng), 0.1f));
+		add(results, Lerp, lerp(t, u, (unit(rng) + 1) / 2));
+	}
+	return results;
+}
+
+// Distance between two floats in representable steps, equal NaNs are zero apart
+u32 ulps(f32 a, f32 b) {
+	i32 x = std::bit_cast<i32>(a), y = std::bit_cast<i32>(b);
+	if (x == y)
+		return 0;
+	if (a != a || b != b)
+		return ~u32(0);
+	// Maps the sign and magnitude bits onto one increasing line
+	auto order = [](i32 bits) { return bits < 0 ? i64(std::numeric_limits<i32>::min()) - bits : i64(bits); };
+	return static_cast<u32>(std::min<i64>(std::abs(order(x) - order(y)), ~u32(0)));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		std::fprintf(stderr, "usage: %s <reference file>\n", argv[0]);
+		return 2;
+	}
+	Results results = compute();
+
+	if constexpr (!simd_math) {
+		std::ofstream file(argv[1], std::ios::binary | std::ios::trunc);
+		for (auto& values : results)
+			file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(f32));
+		file.close();
+		if (!file) {
+			std::fprintf(stderr, "couldn't write %s\n", argv[1]);
+			return 1;
+		}
+		return 0;
+	} else {
+		std::ifstream file(argv[1], std::ios::binary);
+		bool failed = false;
+		for (u32 op = 0; op < op_count; op++) {
+			std::vector<f32> reference(results[op].size());
+			file.read(reinterpret_cast<char*>(reference.data()), reference.size() * sizeof(f32));
+			if (!file) {
+				std::fprintf(stderr, "couldn't read %s from %s\n", ops[op].name, argv[1]);
+				return 1;
+			}
+
+			u32 worst = 0, over = 0;
+			for (size_t i = 0; i < reference.size(); i++) {
+				u32 distance = ulps(results[op][i], reference[i]);
+				worst = std::max(worst, distance);
+				over += distance > ops[op].max_ulps;
+			}
+			bool ok = over == 0;
+			failed |= !ok;
+			std::printf("%-16s %s, %u ULPs at most (bound %u), %u of %zu values over\n", ops[op].name,
+						ok ? "ok" : "FAILED", worst, ops[op].max_ulps, over, reference.size());
+		}
+		return failed ? 1 : 0;
+	}
+}